@@ -0,0 +1,192 @@
+/*
+ * Bulk spawn benchmark: one push of N work units vs N ABT_thread_create()
+ *
+ * The loop pattern is the one of fixed_allocation.c: work units are
+ * created one by one, round-robin over the private pools of the worker
+ * execution streams. The bulk pattern gives each pool its share with a
+ * single bulk_spawn() call. The primary execution stream only spawns;
+ * the clock stops when every work unit has run.
+ *
+ * Usage: 02_abt_bulk_spawn [-x xstreams] [-s units,...] [-r repeats]
+ *                          [-w] [-u]
+ *   -w uses ABT_POOL_FIFO_WAIT pools with ABT_SCHED_BASIC_WAIT, so idle
+ *   workers sleep and every push may wake one up
+ *   -u spawns ULTs instead of tasklets; with 1M units queued at once, the
+ *   ULT stacks need several GB of memory
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <abt.h>
+#include "bulk_spawn.h"
+
+#define NUM_XSTREAMS 4
+#define SIZES "1000,10000,100000,1000000"
+#define MAX_SIZES 16
+#define REPEATS 3
+
+typedef struct {
+    int thread_id;
+    atomic_long *done;
+} thread_arg_t;
+
+void thread_func(void *arg)
+{
+    thread_arg_t *t = (thread_arg_t *)arg;
+    atomic_fetch_add_explicit(t->done, 1, memory_order_relaxed);
+}
+
+typedef struct {
+    double spawn;              /* seconds spent spawning */
+    double total;              /* seconds until every unit ran */
+} run_time_t;
+
+run_time_t run_once(int use_bulk, int num_xstreams, int num_units,
+                    int use_wait, int flags, thread_arg_t *args,
+                    atomic_long *done)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    bulk_spawner_t *bs;
+    run_time_t time;
+
+    ABT_init(0, NULL);
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool_create_basic(use_wait ? ABT_POOL_FIFO_WAIT : ABT_POOL_FIFO,
+                              ABT_POOL_ACCESS_MPMC, ABT_TRUE, &pools[i]);
+        ABT_xstream_create_basic(use_wait ? ABT_SCHED_BASIC_WAIT
+                                          : ABT_SCHED_BASIC,
+                                 1, &pools[i], ABT_SCHED_CONFIG_NULL,
+                                 &xstreams[i]);
+    }
+    bulk_spawner_create(ABT_THREAD_ATTR_NULL, &bs);
+    atomic_store(done, 0);
+
+    double start_time = ABT_get_wtime();
+    if (use_bulk) {
+        /* Pool i gets a contiguous slice of the arguments */
+        for (int i = 0; i < num_xstreams; i++) {
+            int first = (int)((long)num_units * i / num_xstreams);
+            int last = (int)((long)num_units * (i + 1) / num_xstreams);
+            bulk_spawn(bs, pools[i], thread_func, &args[first],
+                       sizeof(thread_arg_t), last - first, flags, NULL);
+        }
+    } else {
+        for (int i = 0; i < num_units; i++) {
+            ABT_pool pool = pools[i % num_xstreams];
+            if (flags & BULK_SPAWN_TASKLETS)
+                ABT_task_create(pool, thread_func, &args[i], NULL);
+            else
+                ABT_thread_create(pool, thread_func, &args[i],
+                                  ABT_THREAD_ATTR_NULL, NULL);
+        }
+    }
+    time.spawn = ABT_get_wtime() - start_time;
+    while (atomic_load_explicit(done, memory_order_relaxed) < num_units)
+        ABT_thread_yield();
+    time.total = ABT_get_wtime() - start_time;
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    bulk_spawner_free(bs);
+    ABT_finalize();
+    free(pools);
+    free(xstreams);
+    return time;
+}
+
+/* Fastest spawn and fastest completion over repeats runs */
+run_time_t run_best(int use_bulk, int num_xstreams, int num_units,
+                    int use_wait, int flags, int repeats, thread_arg_t *args,
+                    atomic_long *done)
+{
+    run_time_t best = {1e30, 1e30};
+    for (int r = 0; r < repeats; r++) {
+        run_time_t time = run_once(use_bulk, num_xstreams, num_units,
+                                   use_wait, flags, args, done);
+        if (time.spawn < best.spawn)
+            best.spawn = time.spawn;
+        if (time.total < best.total)
+            best.total = time.total;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    char size_list[256] = SIZES;
+    int sizes[MAX_SIZES], num_sizes = 0, max_size = 0;
+    int repeats = REPEATS;
+    int use_wait = 0;
+    int flags = BULK_SPAWN_TASKLETS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:s:r:wu")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 's':
+                snprintf(size_list, sizeof(size_list), "%s", optarg);
+                break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'w': use_wait = 1; break;
+            case 'u': flags &= ~BULK_SPAWN_TASKLETS; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-s units,...] "
+                        "[-r repeats] [-w] [-u]\n", argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(size_list, ","); tok && num_sizes < MAX_SIZES;
+         tok = strtok(NULL, ",")) {
+        sizes[num_sizes] = atoi(tok);
+        if (sizes[num_sizes] < 1) {
+            fprintf(stderr, "Error: invalid number of units %s\n", tok);
+            return 1;
+        }
+        if (sizes[num_sizes] > max_size)
+            max_size = sizes[num_sizes];
+        num_sizes++;
+    }
+    if (num_xstreams < 1 || repeats < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    atomic_long done;
+    thread_arg_t *args = malloc(sizeof(thread_arg_t) * max_size);
+    for (int i = 0; i < max_size; i++) {
+        args[i].thread_id = i;
+        args[i].done = &done;
+    }
+
+    printf("=== Bulk Spawn Benchmark ===\n");
+    printf("%d worker xstreams, %s pools, %s, best of %d runs\n\n",
+           num_xstreams, use_wait ? "FIFO_WAIT" : "FIFO",
+           (flags & BULK_SPAWN_TASKLETS) ? "tasklets" : "ULTs", repeats);
+    printf("%-10s %-6s %14s %14s %10s\n", "units", "spawn", "ns/unit",
+           "units/s", "speedup");
+
+    for (int s = 0; s < num_sizes; s++) {
+        run_time_t loop = run_best(0, num_xstreams, sizes[s], use_wait, flags,
+                                   repeats, args, &done);
+        run_time_t bulk = run_best(1, num_xstreams, sizes[s], use_wait, flags,
+                                   repeats, args, &done);
+        printf("%-10d %-6s %14.1f %14.0f\n", sizes[s], "loop",
+               loop.spawn / sizes[s] * 1e9, sizes[s] / loop.total);
+        printf("%-10s %-6s %14.1f %14.0f %9.2fx\n", "", "bulk",
+               bulk.spawn / sizes[s] * 1e9, sizes[s] / bulk.total,
+               loop.total / bulk.total);
+    }
+
+    printf("\nns/unit: time to spawn, per unit; units/s: until all have run\n");
+
+    free(args);
+    return 0;
+}
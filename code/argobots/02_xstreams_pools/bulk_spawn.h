@@ -0,0 +1,133 @@
+/*
+ * Bulk spawn: create N work units and push them into a pool at once
+ *
+ * ABT_thread_create() pushes each new work unit into its pool right away:
+ * with a shared pool, N creations take the pool lock N times and may wake
+ * a waiting scheduler N times. A bulk spawner creates the work units in a
+ * private staging pool that no scheduler reads (no lock, no wakeup), pops
+ * them back, and hands them all to the target pool with a single
+ * ABT_pool_push_threads(). The basic pools implement this as one lock
+ * acquisition, and ABT_POOL_FIFO_WAIT signals its waiters once.
+ *
+ * The work units run func(arg_i) with either
+ *   arg_i = (char *)base + i * stride     (bulk_spawn(), stride 0: same arg)
+ *   arg_i = args[i]                       (bulk_spawn_array())
+ * With BULK_SPAWN_TASKLETS they are tasklets instead of ULTs. If threads
+ * is NULL the work units are unnamed and free themselves when they
+ * terminate; otherwise threads[i] must be freed by the caller.
+ *
+ * The staging pool is private: a spawner must only be used by one
+ * execution stream at a time (create one per xstream).
+ */
+
+#ifndef BULK_SPAWN_H
+#define BULK_SPAWN_H
+
+#include <stdlib.h>
+#include <abt.h>
+
+#define BULK_SPAWN_TASKLETS 0x1
+
+typedef struct {
+    ABT_pool staging;
+    ABT_thread_attr attr;
+    ABT_thread *scratch;       /* handles of unnamed units */
+    size_t capacity;
+} bulk_spawner_t;
+
+/* attr (may be ABT_THREAD_ATTR_NULL) is used for every ULT and must stay
+ * valid until the spawner is freed */
+static inline int bulk_spawner_create(ABT_thread_attr attr,
+                                      bulk_spawner_t **newbs)
+{
+    bulk_spawner_t *bs = (bulk_spawner_t *)calloc(1, sizeof(bulk_spawner_t));
+    if (!bs)
+        return ABT_ERR_MEM;
+    int ret = ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_PRIV,
+                                    ABT_FALSE, &bs->staging);
+    if (ret != ABT_SUCCESS) {
+        free(bs);
+        return ret;
+    }
+    bs->attr = attr;
+    *newbs = bs;
+    return ABT_SUCCESS;
+}
+
+static inline void bulk_spawner_free(bulk_spawner_t *bs)
+{
+    ABT_pool_free(&bs->staging);
+    free(bs->scratch);
+    free(bs);
+}
+
+/* Common part; the i-th argument is args[i] if args, else base + i * stride */
+static inline int bulk_spawn_impl(bulk_spawner_t *bs, ABT_pool pool,
+                                  void (*func)(void *), void **args,
+                                  char *base, size_t stride, size_t num,
+                                  int flags, ABT_thread *threads)
+{
+    ABT_thread *handles = threads;
+    size_t created = 0, popped = 0;
+    int ret = ABT_SUCCESS;
+
+    if (!handles) {
+        if (bs->capacity < num) {
+            ABT_thread *scratch = (ABT_thread *)realloc(bs->scratch,
+                                                        sizeof(ABT_thread) * num);
+            if (!scratch)
+                return ABT_ERR_MEM;
+            bs->scratch = scratch;
+            bs->capacity = num;
+        }
+        handles = bs->scratch;
+    }
+
+    /* Create in the staging pool: nobody else sees it, so this is cheap */
+    for (; created < num; created++) {
+        void *arg = args ? args[created] : base + created * stride;
+        ABT_thread *newthread = threads ? &threads[created] : NULL;
+        if (flags & BULK_SPAWN_TASKLETS)
+            ret = ABT_task_create(bs->staging, func, arg, newthread);
+        else
+            ret = ABT_thread_create(bs->staging, func, arg, bs->attr,
+                                    newthread);
+        if (ret != ABT_SUCCESS)
+            break; /* push what was created so far */
+    }
+
+    /* Pop in creation order; for named units this refills threads[] with
+     * the same handles */
+    while (popped < created) {
+        size_t n = 0;
+        ABT_pool_pop_threads(bs->staging, &handles[popped], created - popped,
+                             &n);
+        if (n == 0)
+            break;
+        popped += n;
+    }
+
+    /* The only operation on the target pool */
+    int push_ret = ABT_pool_push_threads(pool, handles, popped);
+    return ret != ABT_SUCCESS ? ret : push_ret;
+}
+
+/* Spawn num units in pool, unit i running func((char *)base + i * stride) */
+static inline int bulk_spawn(bulk_spawner_t *bs, ABT_pool pool,
+                             void (*func)(void *), void *base, size_t stride,
+                             size_t num, int flags, ABT_thread *threads)
+{
+    return bulk_spawn_impl(bs, pool, func, NULL, (char *)base, stride, num,
+                           flags, threads);
+}
+
+/* Spawn num units in pool, unit i running func(args[i]) */
+static inline int bulk_spawn_array(bulk_spawner_t *bs, ABT_pool pool,
+                                   void (*func)(void *), void **args,
+                                   size_t num, int flags, ABT_thread *threads)
+{
+    return bulk_spawn_impl(bs, pool, func, args, NULL, 0, num, flags,
+                           threads);
+}
+
+#endif /* BULK_SPAWN_H */
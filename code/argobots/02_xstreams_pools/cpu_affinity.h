@@ -0,0 +1,148 @@
+/*
+ * CPU placement helpers for execution streams
+ * Builds the list of CPUs that xstream i should be bound to with
+ * ABT_xstream_set_cpubind(), from the topology exported in /sys
+ *
+ * Files including this header must define _GNU_SOURCE before any #include
+ * (needed for sched_getaffinity() and sched_getcpu()).
+ */
+
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    AFFINITY_NONE,    /* floating: the OS decides where xstreams run */
+    AFFINITY_COMPACT, /* fill SMT siblings of a core before the next core */
+    AFFINITY_SCATTER, /* one xstream per physical core, siblings last */
+    AFFINITY_MAP      /* explicit list of CPUs, e.g. "0,2,4,6" */
+} affinity_policy_t;
+
+typedef struct {
+    int cpu;
+    int package; /* physical_package_id (socket) */
+    int core;    /* core_id within the package */
+    int smt;     /* index of this hardware thread among its core's siblings */
+} cpu_info_t;
+
+static inline int affinity_parse_policy(const char *name, affinity_policy_t *policy)
+{
+    if (strcmp(name, "none") == 0)
+        *policy = AFFINITY_NONE;
+    else if (strcmp(name, "compact") == 0)
+        *policy = AFFINITY_COMPACT;
+    else if (strcmp(name, "scatter") == 0)
+        *policy = AFFINITY_SCATTER;
+    else
+        return -1;
+    return 0;
+}
+
+static inline const char *affinity_policy_name(affinity_policy_t policy)
+{
+    switch (policy) {
+        case AFFINITY_COMPACT: return "compact";
+        case AFFINITY_SCATTER: return "scatter";
+        case AFFINITY_MAP:     return "map";
+        default:               return "none";
+    }
+}
+
+/* Read /sys/devices/system/cpu/cpu<cpu>/topology/<name>, -1 if unavailable */
+static inline int affinity_read_topology(int cpu, const char *name)
+{
+    char path[128];
+    int value = -1;
+    snprintf(path, sizeof(path),
+             "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &value) != 1)
+            value = -1;
+        fclose(f);
+    }
+    return value;
+}
+
+static inline int affinity_cmp_compact(const void *a, const void *b)
+{
+    const cpu_info_t *x = a, *y = b;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static inline int affinity_cmp_scatter(const void *a, const void *b)
+{
+    const cpu_info_t *x = a, *y = b;
+    if (x->smt != y->smt) return x->smt - y->smt;
+    if (x->core != y->core) return x->core - y->core;
+    if (x->package != y->package) return x->package - y->package;
+    return x->cpu - y->cpu;
+}
+
+/*
+ * Fill cpus[] with up to max_cpus CPU ids in the order xstreams should
+ * use them, restricted to the CPUs this process is allowed to run on.
+ * map is only used with AFFINITY_MAP. Returns the number of CPUs, or 0
+ * if the policy is AFFINITY_NONE or nothing could be determined.
+ */
+static inline int affinity_build_cpu_list(affinity_policy_t policy,
+                                          const char *map,
+                                          int *cpus, int max_cpus)
+{
+    int num = 0;
+
+    if (policy == AFFINITY_NONE)
+        return 0;
+
+    if (policy == AFFINITY_MAP) {
+        const char *p = map;
+        while (p && *p && num < max_cpus) {
+            char *end;
+            long cpu = strtol(p, &end, 10);
+            if (end == p || cpu < 0)
+                return 0;
+            cpus[num++] = (int)cpu;
+            p = (*end == ',') ? end + 1 : end;
+        }
+        return num;
+    }
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return 0;
+
+    cpu_info_t *info = malloc(sizeof(cpu_info_t) * CPU_SETSIZE);
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        info[count].cpu = cpu;
+        info[count].package = affinity_read_topology(cpu, "physical_package_id");
+        info[count].core = affinity_read_topology(cpu, "core_id");
+        info[count].smt = 0;
+        /* Hardware threads of the same core get increasing SMT indices */
+        for (int k = 0; k < count; k++) {
+            if (info[k].package == info[count].package &&
+                info[k].core == info[count].core)
+                info[count].smt++;
+        }
+        count++;
+    }
+
+    qsort(info, count, sizeof(cpu_info_t),
+          policy == AFFINITY_COMPACT ? affinity_cmp_compact
+                                     : affinity_cmp_scatter);
+    for (int i = 0; i < count && num < max_cpus; i++)
+        cpus[num++] = info[i].cpu;
+
+    free(info);
+    return num;
+}
+
+#endif /* CPU_AFFINITY_H */
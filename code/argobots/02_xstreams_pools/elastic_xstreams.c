@@ -0,0 +1,361 @@
+/*
+ * Elastic execution streams: park idle xstreams, wake them up under backlog
+ *
+ * Worker xstreams share one service pool. Their scheduler can be parked: a
+ * parked xstream sleeps on a condition variable and uses no CPU until it is
+ * activated again. A controller, running on the primary xstream next to the
+ * load generator, samples the backlog (ABT_pool_get_size) and the recent
+ * dispatch rate every control period:
+ *   - backlog above GROW_BACKLOG per active xstream: activate one more
+ *   - no backlog and utilization below SHRINK_UTIL for SHRINK_PERIODS
+ *     consecutive periods: park one
+ * Growing is immediate and shrinking is slow, so short lulls do not make
+ * the xstream count oscillate.
+ *
+ * The load alternates between a low and a high request rate. The same load
+ * is run with all xstreams active ("fixed") and with the controller
+ * ("elastic"), reporting request latency and the CPU time used by workers.
+ *
+ * Usage: 02_abt_elastic_xstreams [-x max_xstreams] [-w work_us]
+ *                                [-l low_rate] [-r high_rate]
+ *                                [-p phase_ms] [-c cycles]
+ *   rates are in requests per second
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define MAX_XSTREAMS 4
+#define WORK_US 100
+#define LOW_RATE 1000          /* requests per second */
+#define PHASE_MS 500
+#define CYCLES 2               /* low/high phase pairs */
+#define EVENT_FREQ 64
+#define MIN_ACTIVE 1
+#define CONTROL_PERIOD 0.001   /* seconds between controller samples */
+#define GROW_BACKLOG 4         /* queued requests per active xstream */
+#define SHRINK_UTIL 0.5
+#define SHRINK_PERIODS 20
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    pthread_cond_t cond;
+    _Atomic int parked;
+    _Atomic long dispatched;   /* requests run by this xstream */
+    double cpu_time;           /* CPU seconds used by this xstream */
+} worker_t;
+
+typedef struct {
+    double arrival;
+    double *latency;
+} request_t;
+
+worker_t *workers;             /* indexed by xstream rank - 1 */
+double work_time;
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    int *event_freq = (int *)malloc(sizeof(int));
+    ABT_sched_config_read(config, 1, event_freq);
+    ABT_sched_set_data(sched, (void *)event_freq);
+    return ABT_SUCCESS;
+}
+
+/* Sleep without using CPU until the controller activates this xstream */
+static void wait_while_parked(worker_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    while (atomic_load(&w->parked))
+        pthread_cond_wait(&w->cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void sched_run(ABT_sched sched)
+{
+    int *event_freq, rank, work_count = 0;
+    ABT_pool pool;
+
+    ABT_sched_get_data(sched, (void **)&event_freq);
+    ABT_sched_get_pools(sched, 1, 0, &pool);
+    ABT_xstream_self_rank(&rank);
+    worker_t *w = &workers[rank - 1];
+
+    while (1) {
+        ABT_thread thread;
+        ABT_pool_pop_thread(pool, &thread);
+        if (thread != ABT_THREAD_NULL) {
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+            atomic_fetch_add_explicit(&w->dispatched, 1, memory_order_relaxed);
+        }
+
+        if (++work_count >= *event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+            if (atomic_load_explicit(&w->parked, memory_order_relaxed))
+                wait_while_parked(w);
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    w->cpu_time = ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int sched_free(ABT_sched sched)
+{
+    int *event_freq;
+    ABT_sched_get_data(sched, (void **)&event_freq);
+    free(event_freq);
+    return ABT_SUCCESS;
+}
+
+int parkable_sched_create(ABT_pool pool, ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, 1, &pool, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+void set_parked(worker_t *w, int parked)
+{
+    pthread_mutex_lock(&w->lock);
+    atomic_store(&w->parked, parked);
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* ---- Controller ---- */
+
+typedef struct {
+    int num_workers;
+    int active;                /* workers 0 .. active - 1 are running */
+    int idle_periods;
+    long last_dispatched;
+    double active_time;        /* integral of active xstreams over time */
+    int max_active;
+} controller_t;
+
+void controller_step(controller_t *c, ABT_pool pool, double period)
+{
+    size_t backlog;
+    long dispatched = 0;
+
+    ABT_pool_get_size(pool, &backlog);
+    for (int i = 0; i < c->num_workers; i++)
+        dispatched += atomic_load_explicit(&workers[i].dispatched,
+                                           memory_order_relaxed);
+    /* Fraction of the active xstreams' time spent running requests */
+    double util = (dispatched - c->last_dispatched) * work_time /
+                  (period * c->active);
+    c->last_dispatched = dispatched;
+    c->active_time += c->active * period;
+
+    if (backlog > (size_t)(GROW_BACKLOG * c->active) &&
+        c->active < c->num_workers) {
+        set_parked(&workers[c->active++], 0);
+        c->idle_periods = 0;
+    } else if (backlog == 0 && util < SHRINK_UTIL && c->active > MIN_ACTIVE) {
+        if (++c->idle_periods >= SHRINK_PERIODS) {
+            set_parked(&workers[--c->active], 1);
+            c->idle_periods = 0;
+        }
+    } else {
+        c->idle_periods = 0;
+    }
+    if (c->active > c->max_active)
+        c->max_active = c->active;
+}
+
+/* ---- Benchmark ---- */
+
+void request_func(void *arg)
+{
+    request_t *req = (request_t *)arg;
+    double start = ABT_get_wtime();
+    while (ABT_get_wtime() - start < work_time)
+        ;
+    *req->latency = ABT_get_wtime() - req->arrival;
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void run_mode(const char *name, int elastic, int num_workers,
+              const double *rates, int num_phases, double phase_time,
+              int max_requests)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_workers);
+    request_t *requests = malloc(sizeof(request_t) * max_requests);
+    double *latencies = malloc(sizeof(double) * max_requests);
+    controller_t c = {num_workers, elastic ? MIN_ACTIVE : num_workers,
+                      0, 0, 0.0, 0};
+    ABT_pool pool;
+    int num_requests = 0;
+
+    ABT_init(0, NULL);
+
+    ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                          &pool);
+    workers = aligned_alloc(64, sizeof(worker_t) * num_workers);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_mutex_init(&workers[i].lock, NULL);
+        pthread_cond_init(&workers[i].cond, NULL);
+        atomic_init(&workers[i].parked, i >= c.active);
+        atomic_init(&workers[i].dispatched, 0);
+        workers[i].cpu_time = 0.0;
+        ABT_sched sched;
+        parkable_sched_create(pool, &sched);
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+
+    /* Open-loop load: requests arrive on schedule, whatever the backlog */
+    double start_time = ABT_get_wtime();
+    double next_arrival = start_time, next_control = start_time;
+    for (int p = 0; p < num_phases; p++) {
+        double phase_end = start_time + (p + 1) * phase_time;
+        while (1) {
+            double now = ABT_get_wtime();
+            if (now >= phase_end)
+                break;
+            if (elastic && now >= next_control) {
+                controller_step(&c, pool, CONTROL_PERIOD);
+                next_control += CONTROL_PERIOD;
+            }
+            if (now >= next_arrival && num_requests < max_requests) {
+                request_t *req = &requests[num_requests];
+                req->arrival = next_arrival;
+                req->latency = &latencies[num_requests];
+                num_requests++;
+                ABT_thread_create(pool, request_func, req,
+                                  ABT_THREAD_ATTR_NULL, NULL);
+                next_arrival += 1.0 / rates[p];
+            }
+        }
+        /* Do not carry a backlog of arrivals into the next phase */
+        if (next_arrival < phase_end)
+            next_arrival = phase_end;
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+    if (!elastic)
+        c.active_time = num_workers * elapsed;
+
+    /* Parked xstreams must run again to see the join request */
+    for (int i = 0; i < num_workers; i++) {
+        set_parked(&workers[i], 0);
+    }
+    double cpu_time = 0.0;
+    for (int i = 0; i < num_workers; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+        cpu_time += workers[i].cpu_time;
+        pthread_cond_destroy(&workers[i].cond);
+        pthread_mutex_destroy(&workers[i].lock);
+    }
+    ABT_finalize();
+
+    qsort(latencies, num_requests, sizeof(double), compare_double);
+    printf("%-8s %8d %10.2f %10d %13.3f %10.1f %10.1f %10.1f\n", name,
+           num_requests, c.active_time / elapsed,
+           elastic ? c.max_active : num_workers, cpu_time,
+           latencies[num_requests / 2] * 1e6,
+           latencies[(int)(num_requests * 0.99)] * 1e6,
+           latencies[num_requests - 1] * 1e6);
+
+    free(workers);
+    free(latencies);
+    free(requests);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int max_xstreams = MAX_XSTREAMS;
+    int work_us = WORK_US;
+    double low_rate = LOW_RATE, high_rate = 0;
+    int phase_ms = PHASE_MS;
+    int cycles = CYCLES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:w:l:r:p:c:")) != -1) {
+        switch (opt) {
+            case 'x': max_xstreams = atoi(optarg); break;
+            case 'w': work_us = atoi(optarg); break;
+            case 'l': low_rate = atof(optarg); break;
+            case 'r': high_rate = atof(optarg); break;
+            case 'p': phase_ms = atoi(optarg); break;
+            case 'c': cycles = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x max_xstreams] [-w work_us] "
+                        "[-l low_rate] [-r high_rate] [-p phase_ms] "
+                        "[-c cycles]\n", argv[0]);
+                return 1;
+        }
+    }
+    work_time = work_us * 1e-6;
+    /* By default, the high phase needs ~80% of all worker xstreams */
+    if (high_rate == 0)
+        high_rate = 0.8 * max_xstreams / work_time;
+    if (max_xstreams < 1 || work_us < 1 || low_rate <= 0 || high_rate <= 0 ||
+        phase_ms < 1 || cycles < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    int num_phases = 2 * cycles;
+    double *rates = malloc(sizeof(double) * num_phases);
+    double phase_time = phase_ms * 1e-3;
+    int max_requests = 0;
+    for (int p = 0; p < num_phases; p++) {
+        rates[p] = (p % 2 == 0) ? low_rate : high_rate;
+        max_requests += (int)(rates[p] * phase_time) + 1;
+    }
+
+    printf("=== Elastic Execution Streams ===\n");
+    printf("%d worker xstreams, %d us per request, %d x (%.0f/s, %.0f/s) "
+           "phases of %d ms\n\n", max_xstreams, work_us, cycles, low_rate,
+           high_rate, phase_ms);
+    printf("%-8s %8s %10s %10s %13s %10s %10s %10s\n", "mode", "requests",
+           "avg active", "max active", "worker CPU(s)", "p50(us)", "p99(us)",
+           "max(us)");
+
+    run_mode("fixed", 0, max_xstreams, rates, num_phases, phase_time,
+             max_requests);
+    run_mode("elastic", 1, max_xstreams, rates, num_phases, phase_time,
+             max_requests);
+
+    printf("\nElastic mode trades some latency at the start of each burst\n");
+    printf("for the CPU time that idle spinning xstreams burn in fixed mode\n");
+
+    free(rates);
+    return 0;
+}
@@ -1,11 +1,18 @@
 /*
  * Fixed allocation: Each execution stream has its own private pool
  * ULTs are statically assigned to pools and cannot migrate
+ *
+ * Usage: 02_abt_fixed_allocation [-p none|compact|scatter] [-a cpu,cpu,...]
+ *   -p binds each execution stream to a CPU following a placement policy
+ *   -a binds execution stream i to the i-th CPU of an explicit affinity map
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <abt.h>
+#include "cpu_affinity.h"
 
 #define NUM_XSTREAMS 4
 #define NUM_THREADS 16
@@ -22,17 +29,46 @@ void thread_func(void *arg)
     /* Get the rank of the execution stream running this ULT */
     ABT_xstream_self_rank(&xstream_rank);
 
-    printf("ULT %2d executing on ES %d (fixed allocation)\n",
-           thread_id, xstream_rank);
+    printf("ULT %2d executing on ES %d, CPU %d (fixed allocation)\n",
+           thread_id, xstream_rank, sched_getcpu());
 }
 
 int main(int argc, char **argv)
 {
-    int i;
+    int i, opt;
     ABT_xstream xstreams[NUM_XSTREAMS];
     ABT_pool pools[NUM_XSTREAMS];
     ABT_thread threads[NUM_THREADS];
     thread_arg_t thread_args[NUM_THREADS];
+    affinity_policy_t policy = AFFINITY_NONE;
+    const char *affinity_map = NULL;
+    int cpus[NUM_XSTREAMS];
+    int num_cpus;
+
+    while ((opt = getopt(argc, argv, "p:a:")) != -1) {
+        switch (opt) {
+            case 'p':
+                if (affinity_parse_policy(optarg, &policy) != 0) {
+                    fprintf(stderr, "Error: unknown policy %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'a':
+                policy = AFFINITY_MAP;
+                affinity_map = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p none|compact|scatter] "
+                        "[-a cpu,cpu,...]\n", argv[0]);
+                return 1;
+        }
+    }
+    num_cpus = affinity_build_cpu_list(policy, affinity_map, cpus, NUM_XSTREAMS);
+    if (policy != AFFINITY_NONE && num_cpus == 0) {
+        fprintf(stderr, "Error: could not determine CPUs for policy %s\n",
+                affinity_policy_name(policy));
+        return 1;
+    }
 
     /* Initialize Argobots */
     ABT_init(argc, argv);
@@ -53,6 +89,24 @@ int main(int argc, char **argv)
         ABT_xstream_get_main_pools(xstreams[i], 1, &pools[i]);
     }
 
+    /* Optionally pin each execution stream to a CPU so the OS cannot
+       migrate it (and its pool's working set) to another core.
+       If the map is shorter than the number of xstreams, it wraps around. */
+    if (num_cpus > 0) {
+        printf("Placement policy: %s\n", affinity_policy_name(policy));
+        for (i = 0; i < NUM_XSTREAMS; i++) {
+            int cpu = cpus[i % num_cpus];
+            if (ABT_xstream_set_cpubind(xstreams[i], cpu) != ABT_SUCCESS) {
+                fprintf(stderr, "Warning: could not bind ES %d to CPU %d\n",
+                        i, cpu);
+                continue;
+            }
+            ABT_xstream_get_cpubind(xstreams[i], &cpu);
+            printf("  ES %d bound to CPU %d\n", i, cpu);
+        }
+        printf("\n");
+    }
+
     /* Create ULTs and assign them to pools in round-robin fashion */
     for (i = 0; i < NUM_THREADS; i++) {
         int pool_id = i % NUM_XSTREAMS;
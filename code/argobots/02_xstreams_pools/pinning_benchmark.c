@@ -0,0 +1,258 @@
+/*
+ * Pinned vs floating execution streams: ULT dispatch throughput and tail latency
+ * Each execution stream repeatedly creates ULTs in its private pool; every ULT
+ * records how long it waited before running and touches a per-xstream buffer
+ * so that migrations between cores show up as cache misses.
+ *
+ * Usage: 02_abt_pinning_benchmark [-x xstreams] [-n ults_per_xstream]
+ *                                 [-w working_set_kb] [-b background_threads]
+ *                                 [-p compact|scatter] [-a cpu,cpu,...]
+ *   -b starts unpinned busy pthreads to reproduce a loaded node
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <abt.h>
+#include "cpu_affinity.h"
+
+#define NUM_XSTREAMS 4
+#define ULTS_PER_XSTREAM 100000
+#define BATCH_SIZE 64
+#define WORKING_SET_KB 32
+#define MAX_CPUS 1024
+
+typedef struct {
+    ABT_pool pool;
+    int num_ults;
+    double *latencies;     /* dispatch latency of each ULT, in seconds */
+    char *working_set;
+    size_t working_set_size;
+    int last_cpu;
+    long migrations;       /* CPU changes observed by this xstream's ULTs */
+    long checksum;
+} xstream_ctx_t;
+
+typedef struct {
+    double create_time;
+    double *latency;
+    xstream_ctx_t *ctx;
+} ult_arg_t;
+
+static volatile int background_stop = 0;
+
+void ult_func(void *arg)
+{
+    ult_arg_t *ult = (ult_arg_t *)arg;
+    xstream_ctx_t *ctx = ult->ctx;
+
+    *ult->latency = ABT_get_wtime() - ult->create_time;
+
+    int cpu = sched_getcpu();
+    if (cpu != ctx->last_cpu) {
+        if (ctx->last_cpu >= 0)
+            ctx->migrations++;
+        ctx->last_cpu = cpu;
+    }
+
+    /* Touch the xstream's working set, one cache line at a time */
+    long sum = 0;
+    for (size_t i = 0; i < ctx->working_set_size; i += 64) {
+        sum += ctx->working_set[i]++;
+    }
+    ctx->checksum += sum;
+}
+
+/* Runs on each xstream: creates ULTs in batches and waits for them */
+void driver_func(void *arg)
+{
+    xstream_ctx_t *ctx = (xstream_ctx_t *)arg;
+    ABT_thread threads[BATCH_SIZE];
+    ult_arg_t args[BATCH_SIZE];
+
+    for (int done = 0; done < ctx->num_ults; done += BATCH_SIZE) {
+        int batch = ctx->num_ults - done;
+        if (batch > BATCH_SIZE)
+            batch = BATCH_SIZE;
+        for (int i = 0; i < batch; i++) {
+            args[i].ctx = ctx;
+            args[i].latency = &ctx->latencies[done + i];
+            args[i].create_time = ABT_get_wtime();
+            ABT_thread_create(ctx->pool, ult_func, &args[i],
+                              ABT_THREAD_ATTR_NULL, &threads[i]);
+        }
+        for (int i = 0; i < batch; i++) {
+            ABT_thread_free(&threads[i]);
+        }
+    }
+}
+
+void *background_func(void *arg)
+{
+    volatile unsigned long spin = 0;
+    while (!background_stop)
+        spin++;
+    return NULL;
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Run the benchmark once with the given placement and print one result row */
+void run_placement(const char *name, int num_xstreams, int ults_per_xstream,
+                   size_t working_set_size, const int *cpus, int num_cpus)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_thread *drivers = malloc(sizeof(ABT_thread) * num_xstreams);
+    xstream_ctx_t *ctxs = calloc(num_xstreams, sizeof(xstream_ctx_t));
+    int total = num_xstreams * ults_per_xstream;
+    double *latencies = malloc(sizeof(double) * total);
+    int unpinned = 0;
+
+    ABT_init(0, NULL);
+
+    ABT_xstream_self(&xstreams[0]);
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_create(ABT_SCHED_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        if (num_cpus > 0 &&
+            ABT_xstream_set_cpubind(xstreams[i], cpus[i % num_cpus]) !=
+                ABT_SUCCESS) {
+            fprintf(stderr, "Warning: could not bind ES %d to CPU %d\n", i,
+                    cpus[i % num_cpus]);
+            unpinned++;
+        }
+        ABT_xstream_get_main_pools(xstreams[i], 1, &ctxs[i].pool);
+        ctxs[i].num_ults = ults_per_xstream;
+        ctxs[i].latencies = &latencies[i * ults_per_xstream];
+        ctxs[i].working_set = calloc(1, working_set_size);
+        ctxs[i].working_set_size = working_set_size;
+        ctxs[i].last_cpu = -1;
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_create(ctxs[i].pool, driver_func, &ctxs[i],
+                          ABT_THREAD_ATTR_NULL, &drivers[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_free(&drivers[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    ABT_finalize();
+
+    long migrations = 0;
+    for (int i = 0; i < num_xstreams; i++) {
+        migrations += ctxs[i].migrations;
+        free(ctxs[i].working_set);
+    }
+
+    /* A placement row with floating xstreams is marked with a '*' */
+    char label[32];
+    snprintf(label, sizeof(label), "%s%s", name, unpinned ? "*" : "");
+    if (unpinned) {
+        fprintf(stderr, "Warning: %s*: %d of %d xstreams are not pinned\n",
+                name, unpinned, num_xstreams);
+    }
+
+    qsort(latencies, total, sizeof(double), compare_double);
+    printf("%-10s %12.0f %10.2f %10.2f %10.2f %10.2f %11ld\n", label,
+           total / elapsed,
+           latencies[total / 2] * 1e6,
+           latencies[(int)(total * 0.99)] * 1e6,
+           latencies[(int)(total * 0.999)] * 1e6,
+           latencies[total - 1] * 1e6,
+           migrations);
+
+    free(latencies);
+    free(ctxs);
+    free(drivers);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int ults_per_xstream = ULTS_PER_XSTREAM;
+    int working_set_kb = WORKING_SET_KB;
+    int num_background = 0;
+    affinity_policy_t policy = AFFINITY_COMPACT;
+    const char *affinity_map = NULL;
+    int cpus[MAX_CPUS];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:w:b:p:a:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': ults_per_xstream = atoi(optarg); break;
+            case 'w': working_set_kb = atoi(optarg); break;
+            case 'b': num_background = atoi(optarg); break;
+            case 'p':
+                if (affinity_parse_policy(optarg, &policy) != 0 ||
+                    policy == AFFINITY_NONE) {
+                    fprintf(stderr, "Error: policy must be compact or scatter\n");
+                    return 1;
+                }
+                break;
+            case 'a':
+                policy = AFFINITY_MAP;
+                affinity_map = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n ults_per_xstream] "
+                        "[-w working_set_kb] [-b background_threads] "
+                        "[-p compact|scatter] [-a cpu,cpu,...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || ults_per_xstream < 1 || working_set_kb < 0 ||
+        num_background < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    int num_cpus = affinity_build_cpu_list(policy, affinity_map, cpus, MAX_CPUS);
+    if (num_cpus == 0) {
+        fprintf(stderr, "Error: could not determine CPUs for policy %s\n",
+                affinity_policy_name(policy));
+        return 1;
+    }
+
+    printf("=== Pinned vs Floating Execution Streams ===\n");
+    printf("%d xstreams, %d ULTs per xstream, %d KB working set, "
+           "%d background threads\n\n", num_xstreams, ults_per_xstream,
+           working_set_kb, num_background);
+
+    pthread_t *background = malloc(sizeof(pthread_t) * (num_background + 1));
+    for (int i = 0; i < num_background; i++) {
+        pthread_create(&background[i], NULL, background_func, NULL);
+    }
+
+    printf("%-10s %12s %10s %10s %10s %10s %11s\n", "placement", "ULTs/s",
+           "p50(us)", "p99(us)", "p99.9(us)", "max(us)", "migrations");
+    run_placement("floating", num_xstreams, ults_per_xstream,
+                  (size_t)working_set_kb * 1024, NULL, 0);
+    run_placement(affinity_policy_name(policy), num_xstreams, ults_per_xstream,
+                  (size_t)working_set_kb * 1024, cpus, num_cpus);
+
+    background_stop = 1;
+    for (int i = 0; i < num_background; i++) {
+        pthread_join(background[i], NULL);
+    }
+    free(background);
+
+    printf("\nPinned xstreams keep their pool and working set on one core;\n");
+    printf("compare the tail latencies and migration counts under load (-b)\n");
+    return 0;
+}
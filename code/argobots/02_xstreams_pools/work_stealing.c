@@ -1,6 +1,10 @@
 /*
  * Work-stealing: Execution streams share pools and can steal work from each other
  * This improves load balancing when some execution streams finish their work early
+ *
+ * Usage: 02_abt_work_stealing [-x xstreams] [-n ults] [-s light_work_us] [-c]
+ *   -c prints a single CSV record instead of per-ULT messages
+ *      (this is the format expected by 10_performance_debug/scaling_sweep.sh)
  */
 
 #include <stdio.h>
@@ -10,11 +14,15 @@
 
 #define NUM_XSTREAMS 4
 #define NUM_THREADS 16
+#define LIGHT_WORK_US 10000 /* heavy work is 10x this */
 
 typedef struct {
     int thread_id;
 } thread_arg_t;
 
+static int light_work_us = LIGHT_WORK_US;
+static int verbose = 1;
+
 void thread_func(void *arg)
 {
     int thread_id = ((thread_arg_t *)arg)->thread_id;
@@ -23,38 +31,63 @@ void thread_func(void *arg)
     /* Get the rank of the execution stream running this ULT */
     ABT_xstream_self_rank(&xstream_rank);
 
-    printf("ULT %2d executing on ES %d", thread_id, xstream_rank);
-
     /* Simulate varying work amounts */
     if (thread_id % 4 == 0) {
-        printf(" (heavy work)");
-        usleep(100000); /* 100ms */
+        if (verbose)
+            printf("ULT %2d executing on ES %d (heavy work)\n",
+                   thread_id, xstream_rank);
+        usleep(10 * light_work_us); /* 100ms by default */
     } else {
-        printf(" (light work)");
-        usleep(10000);  /* 10ms */
+        if (verbose)
+            printf("ULT %2d executing on ES %d (light work)\n",
+                   thread_id, xstream_rank);
+        usleep(light_work_us);      /* 10ms by default */
     }
-    printf("\n");
 }
 
 int main(int argc, char **argv)
 {
-    int i, j;
-    ABT_xstream xstreams[NUM_XSTREAMS];
-    ABT_pool pools[NUM_XSTREAMS];
-    ABT_sched scheds[NUM_XSTREAMS];
-    ABT_thread threads[NUM_THREADS];
-    thread_arg_t thread_args[NUM_THREADS];
+    int i, j, opt;
+    int num_xstreams = NUM_XSTREAMS;
+    int num_threads = NUM_THREADS;
+    int csv = 0;
+    double start_time, elapsed;
+
+    while ((opt = getopt(argc, argv, "x:n:s:c")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_threads = atoi(optarg); break;
+            case 's': light_work_us = atoi(optarg); break;
+            case 'c': csv = 1; verbose = 0; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n ults] "
+                        "[-s light_work_us] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_threads < 1 || light_work_us < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_sched *scheds = malloc(sizeof(ABT_sched) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_threads);
+    thread_arg_t *thread_args = malloc(sizeof(thread_arg_t) * num_threads);
 
     /* Initialize Argobots */
     ABT_init(argc, argv);
 
-    printf("=== Work-Stealing Example ===\n");
-    printf("Creating %d execution streams with shared pools\n\n", NUM_XSTREAMS);
+    if (verbose) {
+        printf("=== Work-Stealing Example ===\n");
+        printf("Creating %d execution streams with shared pools\n\n", num_xstreams);
+    }
 
     /* Create pools with work-stealing capability
        ABT_POOL_ACCESS_MPMC = Multiple Producers, Multiple Consumers
        This allows multiple execution streams to access the pool */
-    for (i = 0; i < NUM_XSTREAMS; i++) {
+    for (i = 0; i < num_xstreams; i++) {
         ABT_pool_create_basic(ABT_POOL_FIFO,           /* Pool kind: FIFO */
                               ABT_POOL_ACCESS_MPMC,    /* Access: thread-safe */
                               ABT_TRUE,                /* Automatic free */
@@ -63,17 +96,17 @@ int main(int argc, char **argv)
 
     /* Create schedulers that can access ALL pools
        Each scheduler can steal work from other pools when its own pool is empty */
-    for (i = 0; i < NUM_XSTREAMS; i++) {
-        ABT_pool *sched_pools = (ABT_pool *)malloc(sizeof(ABT_pool) * NUM_XSTREAMS);
+    for (i = 0; i < num_xstreams; i++) {
+        ABT_pool *sched_pools = (ABT_pool *)malloc(sizeof(ABT_pool) * num_xstreams);
 
         /* Pool priority order: own pool first, then others in round-robin */
-        for (j = 0; j < NUM_XSTREAMS; j++) {
-            sched_pools[j] = pools[(i + j) % NUM_XSTREAMS];
+        for (j = 0; j < num_xstreams; j++) {
+            sched_pools[j] = pools[(i + j) % num_xstreams];
         }
 
         /* Create a scheduler with access to all pools */
         ABT_sched_create_basic(ABT_SCHED_DEFAULT,      /* Default scheduler */
-                               NUM_XSTREAMS,            /* Number of pools */
+                               num_xstreams,            /* Number of pools */
                                sched_pools,             /* Array of pools */
                                ABT_SCHED_CONFIG_NULL,   /* Default config */
                                &scheds[i]);
@@ -85,14 +118,16 @@ int main(int argc, char **argv)
     ABT_xstream_set_main_sched(xstreams[0], scheds[0]);
 
     /* Create secondary execution streams with their schedulers */
-    for (i = 1; i < NUM_XSTREAMS; i++) {
+    for (i = 1; i < num_xstreams; i++) {
         ABT_xstream_create(scheds[i], &xstreams[i]);
     }
 
     /* Create ULTs and add them to pools */
-    printf("Creating %d ULTs (some with heavy work)...\n\n", NUM_THREADS);
-    for (i = 0; i < NUM_THREADS; i++) {
-        int pool_id = i % NUM_XSTREAMS;
+    if (verbose)
+        printf("Creating %d ULTs (some with heavy work)...\n\n", num_threads);
+    start_time = ABT_get_wtime();
+    for (i = 0; i < num_threads; i++) {
+        int pool_id = i % num_xstreams;
         thread_args[i].thread_id = i;
 
         /* ULTs are initially added to specific pools, but can be stolen
@@ -102,23 +137,36 @@ int main(int argc, char **argv)
     }
 
     /* Wait for all ULTs to complete */
-    for (i = 0; i < NUM_THREADS; i++) {
+    for (i = 0; i < num_threads; i++) {
         ABT_thread_join(threads[i]);
         ABT_thread_free(&threads[i]);
     }
+    elapsed = ABT_get_wtime() - start_time;
 
     /* Join and free secondary execution streams */
-    for (i = 1; i < NUM_XSTREAMS; i++) {
+    for (i = 1; i < num_xstreams; i++) {
         ABT_xstream_join(xstreams[i]);
         ABT_xstream_free(&xstreams[i]);
     }
 
-    printf("\nAll ULTs completed\n");
-    printf("Note: ULTs may have executed on different execution streams\n");
-    printf("      due to work-stealing for better load balancing\n");
+    if (csv) {
+        /* benchmark,xstreams,units,size,seconds,throughput */
+        printf("work_stealing,%d,%d,%d,%.6f,%.2f\n", num_xstreams,
+               num_threads, light_work_us, elapsed, num_threads / elapsed);
+    } else {
+        printf("\nAll ULTs completed in %.3f s\n", elapsed);
+        printf("Note: ULTs may have executed on different execution streams\n");
+        printf("      due to work-stealing for better load balancing\n");
+    }
 
     /* Finalize Argobots */
     ABT_finalize();
 
+    free(thread_args);
+    free(threads);
+    free(scheds);
+    free(pools);
+    free(xstreams);
+
     return 0;
 }
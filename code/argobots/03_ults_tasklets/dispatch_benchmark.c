@@ -0,0 +1,359 @@
+/*
+ * Dispatch Benchmark: what a ULT, a tasklet and a revived ULT cost
+ * Measures creation, first-dispatch latency, join and free in ns/op with
+ * percentiles, and the memory held by each live work unit
+ *
+ * A driver ULT creates batch units in a pool shared by x xstreams (the
+ * driver runs there too), waits until they all ran, then joins and frees
+ * them. Every operation is timed on its own:
+ *   create:   ABT_thread_create, ABT_task_create, or ABT_thread_revive
+ *   dispatch: from the create call to the first instruction of the unit
+ *   join:     ABT_thread_join of a unit that already terminated
+ *   free:     ABT_thread_free (revived ULTs are kept for the next round)
+ * Dispatch latency includes the time the unit waits behind the rest of
+ * its batch; use -b 1 for the latency of a lone unit.
+ *
+ * Memory is measured in a child process per kind, so that memory freed
+ * by one kind is not reused by the next: n units are created without
+ * running, and the growth of the process is divided by n.
+ *
+ * Usage: 03_abt_dispatch_benchmark [-x xstreams,...] [-a access,...]
+ *                                  [-n units] [-b batch]
+ *   access modes: mpmc, mpsc, spmc, spsc, priv; only mpmc is run with
+ *   more than one xstream
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+#include <abt.h>
+
+#define XSTREAMS "1,2,4"
+#define ACCESS_MODES "mpmc,spsc,priv"
+#define MAX_CONFIGS 16
+#define NUM_UNITS 100000
+#define BATCH 64
+#define MEM_UNITS 10000
+
+typedef enum { KIND_ULT, KIND_TASKLET, KIND_REVIVED, NUM_KINDS } kind_t;
+enum { PHASE_CREATE, PHASE_DISPATCH, PHASE_JOIN, PHASE_FREE, NUM_PHASES };
+
+static const char *kind_names[NUM_KINDS] = {"ULT", "tasklet", "revived"};
+static const char *phase_names[NUM_PHASES] = {"create", "dispatch", "join",
+                                              "free"};
+
+static const struct {
+    const char *name;
+    ABT_pool_access access;
+} access_modes[] = {
+    {"mpmc", ABT_POOL_ACCESS_MPMC},
+    {"mpsc", ABT_POOL_ACCESS_MPSC},
+    {"spmc", ABT_POOL_ACCESS_SPMC},
+    {"spsc", ABT_POOL_ACCESS_SPSC},
+    {"priv", ABT_POOL_ACCESS_PRIV},
+};
+#define NUM_ACCESS_MODES (int)(sizeof(access_modes) / sizeof(access_modes[0]))
+
+typedef struct {
+    double start;              /* when the unit started running */
+    atomic_int *done;
+} unit_arg_t;
+
+typedef struct {
+    kind_t kind;
+    ABT_pool pool;
+    int num_units;
+    int batch;
+    double *samples[NUM_PHASES];
+} driver_arg_t;
+
+void unit_func(void *arg)
+{
+    unit_arg_t *unit = (unit_arg_t *)arg;
+    unit->start = ABT_get_wtime();
+    atomic_fetch_add_explicit(unit->done, 1, memory_order_release);
+}
+
+void driver_func(void *arg)
+{
+    driver_arg_t *d = (driver_arg_t *)arg;
+    ABT_thread *units = malloc(sizeof(ABT_thread) * d->batch);
+    unit_arg_t *args = malloc(sizeof(unit_arg_t) * d->batch);
+    double *issued = malloc(sizeof(double) * d->batch);
+    atomic_int done;
+
+    for (int i = 0; i < d->batch; i++)
+        args[i].done = &done;
+
+    /* Revived ULTs are created, run and joined once, untimed */
+    if (d->kind == KIND_REVIVED) {
+        atomic_init(&done, 0);
+        for (int i = 0; i < d->batch; i++)
+            ABT_thread_create(d->pool, unit_func, &args[i],
+                              ABT_THREAD_ATTR_NULL, &units[i]);
+        for (int i = 0; i < d->batch; i++)
+            ABT_thread_join(units[i]);
+    }
+
+    for (int base = 0; base < d->num_units; base += d->batch) {
+        int num = d->num_units - base < d->batch ? d->num_units - base
+                                                 : d->batch;
+        atomic_init(&done, 0);
+
+        for (int i = 0; i < num; i++) {
+            double t = ABT_get_wtime();
+            if (d->kind == KIND_ULT)
+                ABT_thread_create(d->pool, unit_func, &args[i],
+                                  ABT_THREAD_ATTR_NULL, &units[i]);
+            else if (d->kind == KIND_TASKLET)
+                ABT_task_create(d->pool, unit_func, &args[i], &units[i]);
+            else
+                ABT_thread_revive(d->pool, unit_func, &args[i], &units[i]);
+            d->samples[PHASE_CREATE][base + i] = ABT_get_wtime() - t;
+            issued[i] = t;
+        }
+
+        /* Let the batch run, so that join only measures the join */
+        while (atomic_load_explicit(&done, memory_order_acquire) < num)
+            ABT_thread_yield();
+
+        for (int i = 0; i < num; i++) {
+            d->samples[PHASE_DISPATCH][base + i] = args[i].start - issued[i];
+            double t = ABT_get_wtime();
+            ABT_thread_join(units[i]);
+            d->samples[PHASE_JOIN][base + i] = ABT_get_wtime() - t;
+        }
+        if (d->kind != KIND_REVIVED) {
+            for (int i = 0; i < num; i++) {
+                double t = ABT_get_wtime();
+                ABT_thread_free(&units[i]);
+                d->samples[PHASE_FREE][base + i] = ABT_get_wtime() - t;
+            }
+        }
+    }
+
+    if (d->kind == KIND_REVIVED) {
+        for (int i = 0; i < d->batch; i++)
+            ABT_thread_free(&units[i]);
+    }
+    free(issued);
+    free(args);
+    free(units);
+}
+
+void run_config(kind_t kind, ABT_pool_access access, int num_xstreams,
+                int num_units, int batch, double **samples)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    driver_arg_t darg = {kind, ABT_POOL_NULL, num_units, batch, {NULL}};
+    ABT_thread driver;
+
+    ABT_init(0, NULL);
+
+    ABT_pool_create_basic(ABT_POOL_FIFO, access, ABT_TRUE, &darg.pool);
+    for (int p = 0; p < NUM_PHASES; p++)
+        darg.samples[p] = samples[p];
+
+    /* Queue the driver before any xstream can pop from the pool */
+    ABT_thread_create(darg.pool, driver_func, &darg, ABT_THREAD_ATTR_NULL,
+                      &driver);
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &darg.pool,
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    ABT_thread_free(&driver);
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+
+    ABT_finalize();
+    free(xstreams);
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void print_phase(const char *kind, const char *phase, double *samples,
+                 int num)
+{
+    double sum = 0.0;
+    qsort(samples, num, sizeof(double), compare_double);
+    for (int i = 0; i < num; i++)
+        sum += samples[i];
+    printf("  %-8s %-9s %9.0f %9.0f %9.0f %9.0f %10.0f\n", kind, phase,
+           sum / num * 1e9, samples[num / 2] * 1e9,
+           samples[(int)(num * 0.90)] * 1e9, samples[(int)(num * 0.99)] * 1e9,
+           samples[num - 1] * 1e9);
+}
+
+/* Size and resident memory of the process, in bytes */
+void process_bytes(size_t *size, size_t *resident)
+{
+    long pages = 0, rss = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &rss) != 2)
+            pages = rss = 0;
+        fclose(f);
+    }
+    *size = (size_t)pages * (size_t)sysconf(_SC_PAGESIZE);
+    *resident = (size_t)rss * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/* Runs in a child process: prints the memory held by each live unit */
+void measure_memory(kind_t kind, int num_units)
+{
+    ABT_xstream xstream;
+    ABT_pool pool;
+    ABT_thread *units = malloc(sizeof(ABT_thread) * num_units);
+    unit_arg_t *args = malloc(sizeof(unit_arg_t) * num_units);
+    atomic_int done;
+    size_t size0, rss0, size1, rss1;
+
+    atomic_init(&done, 0);
+    for (int i = 0; i < num_units; i++)
+        args[i].done = &done;
+
+    ABT_init(0, NULL);
+    ABT_xstream_self(&xstream);
+    ABT_xstream_get_main_pools(xstream, 1, &pool);
+
+    if (kind == KIND_REVIVED) {
+        /* What a revive adds once the ULTs exist and have terminated */
+        for (int i = 0; i < num_units; i++)
+            ABT_thread_create(pool, unit_func, &args[i],
+                              ABT_THREAD_ATTR_NULL, &units[i]);
+        for (int i = 0; i < num_units; i++)
+            ABT_thread_join(units[i]);
+    }
+
+    /* The primary ULT does not yield: every unit is alive at once */
+    process_bytes(&size0, &rss0);
+    for (int i = 0; i < num_units; i++) {
+        if (kind == KIND_ULT)
+            ABT_thread_create(pool, unit_func, &args[i], ABT_THREAD_ATTR_NULL,
+                              &units[i]);
+        else if (kind == KIND_TASKLET)
+            ABT_task_create(pool, unit_func, &args[i], &units[i]);
+        else
+            ABT_thread_revive(pool, unit_func, &args[i], &units[i]);
+    }
+    process_bytes(&size1, &rss1);
+
+    printf("  %-8s %14.0f %14.0f\n", kind_names[kind],
+           size1 > size0 ? (double)(size1 - size0) / num_units : 0.0,
+           rss1 > rss0 ? (double)(rss1 - rss0) / num_units : 0.0);
+    fflush(stdout);
+
+    for (int i = 0; i < num_units; i++)
+        ABT_thread_free(&units[i]);
+    ABT_finalize();
+    free(args);
+    free(units);
+}
+
+int main(int argc, char **argv)
+{
+    char xstream_list[256] = XSTREAMS;
+    char access_list[256] = ACCESS_MODES;
+    int xstream_counts[MAX_CONFIGS], num_counts = 0;
+    int modes[MAX_CONFIGS], num_modes = 0;
+    int num_units = NUM_UNITS;
+    int batch = BATCH;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:a:n:b:")) != -1) {
+        switch (opt) {
+            case 'x':
+                snprintf(xstream_list, sizeof(xstream_list), "%s", optarg);
+                break;
+            case 'a':
+                snprintf(access_list, sizeof(access_list), "%s", optarg);
+                break;
+            case 'n': num_units = atoi(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams,...] [-a access,...] "
+                        "[-n units] [-b batch]\n", argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(xstream_list, ",");
+         tok && num_counts < MAX_CONFIGS; tok = strtok(NULL, ",")) {
+        xstream_counts[num_counts] = atoi(tok);
+        if (xstream_counts[num_counts] < 1) {
+            fprintf(stderr, "Error: invalid xstream count %s\n", tok);
+            return 1;
+        }
+        num_counts++;
+    }
+    for (char *tok = strtok(access_list, ",");
+         tok && num_modes < MAX_CONFIGS; tok = strtok(NULL, ",")) {
+        int m = 0;
+        while (m < NUM_ACCESS_MODES && strcmp(tok, access_modes[m].name))
+            m++;
+        if (m == NUM_ACCESS_MODES) {
+            fprintf(stderr, "Error: unknown access mode %s\n", tok);
+            return 1;
+        }
+        modes[num_modes++] = m;
+    }
+    if (num_units < 1 || batch < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Dispatch Benchmark ===\n\n");
+    printf("Memory per live unit (bytes, %d units):\n", MEM_UNITS);
+    printf("  %-8s %14s %14s\n", "kind", "address space", "resident");
+    fflush(stdout);
+    for (int k = 0; k < NUM_KINDS; k++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            measure_memory((kind_t)k, MEM_UNITS);
+            _exit(0);
+        }
+        waitpid(pid, NULL, 0);
+    }
+
+    double *samples[NUM_PHASES];
+    for (int p = 0; p < NUM_PHASES; p++)
+        samples[p] = malloc(sizeof(double) * num_units);
+
+    printf("\nLatency (ns/op, %d units per kind, batches of %d)\n", num_units,
+           batch);
+    for (int c = 0; c < num_counts; c++) {
+        for (int m = 0; m < num_modes; m++) {
+            int x = xstream_counts[c];
+            ABT_pool_access access = access_modes[modes[m]].access;
+
+            /* Joins push the joiner back from any xstream */
+            if (x > 1 && access != ABT_POOL_ACCESS_MPMC)
+                continue;
+            printf("\n%d xstream%s, %s pool\n", x, x > 1 ? "s" : "",
+                   access_modes[modes[m]].name);
+            printf("  %-8s %-9s %9s %9s %9s %9s %10s\n", "kind", "op", "mean",
+                   "p50", "p90", "p99", "max");
+            for (int k = 0; k < NUM_KINDS; k++) {
+                run_config((kind_t)k, access, x, num_units, batch, samples);
+                for (int p = 0; p < NUM_PHASES; p++) {
+                    if (p == PHASE_FREE && k == KIND_REVIVED)
+                        continue;
+                    print_phase(kind_names[k], phase_names[p], samples[p],
+                                num_units);
+                }
+            }
+        }
+    }
+
+    for (int p = 0; p < NUM_PHASES; p++)
+        free(samples[p]);
+    return 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Stack Pool Example: user-provided ULT stacks from a size-class allocator
+ * Profiles the stack high-water mark of ULT functions, then creates a large
+ * number of ULTs with Argobots-allocated stacks and with the stack pool
+ *
+ * Part 1 runs a few functions on painted 64KB stacks and prints how much
+ * stack each one really used, with a suggested size class.
+ * Part 2 keeps n ULTs alive at once (they are all created before any of
+ * them runs) and reports the creation rate and the memory they hold. The
+ * second round on the stack pool reuses the stacks of the first one.
+ *
+ * Usage: 03_abt_stack_pool [-n ults] [-s stack_bytes] [-g] [-H]
+ *   -g adds a guard page below each pooled stack, -H backs the pool with
+ *   huge pages
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+#include "stack_pool.h"
+
+#define NUM_ULTS 100000
+#define STACK_SIZE 16384           /* ult_example.c's stack size */
+#define PROFILE_STACK_SIZE 65536
+#define PROFILE_ULTS 16
+
+volatile int sink;
+
+typedef struct {
+    int task_id;
+    int value;
+} task_arg_t;
+
+/* Same computation as simple_func in simple_example.c, without the printf */
+void simple_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    sink = task->value * task->value;
+}
+
+int fibonacci(int n)
+{
+    if (n <= 1) return n;
+    return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+void fib_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    sink = fibonacci(task->value);
+}
+
+void buffer_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    char buffer[24 * 1024];
+    memset(buffer, task->value, sizeof(buffer));
+    sink = buffer[task->task_id % sizeof(buffer)];
+}
+
+void printf_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    char line[64];
+    snprintf(line, sizeof(line), "Task %d: %d^2 = %d", task->task_id,
+             task->value, task->value * task->value);
+    sink = line[0];
+}
+
+/* Resident memory of the process, in bytes */
+size_t resident_bytes(void)
+{
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+void profile_functions(void)
+{
+    stack_pool_t *sp;
+    ABT_xstream xstream;
+    ABT_pool pool;
+    ABT_thread threads[PROFILE_ULTS];
+    task_arg_t args[PROFILE_ULTS];
+    struct {
+        const char *name;
+        void (*func)(void *);
+        int value;
+    } funcs[] = {
+        {"simple_func", simple_func, 10},
+        {"fib_func(20)", fib_func, 20},
+        {"printf_func", printf_func, 10},
+        {"buffer_func", buffer_func, 1},
+    };
+    int num_funcs = sizeof(funcs) / sizeof(funcs[0]);
+
+    ABT_init(0, NULL);
+    ABT_xstream_self(&xstream);
+    ABT_xstream_get_main_pools(xstream, 1, &pool);
+    stack_pool_create(STACK_POOL_GUARD | STACK_POOL_PAINT, &sp);
+
+    for (int f = 0; f < num_funcs; f++) {
+        for (int i = 0; i < PROFILE_ULTS; i++) {
+            args[i].task_id = i;
+            args[i].value = funcs[f].value;
+            stack_pool_thread_create(sp, pool, funcs[f].func, &args[i],
+                                     PROFILE_STACK_SIZE, funcs[f].name,
+                                     &threads[i]);
+        }
+        for (int i = 0; i < PROFILE_ULTS; i++) {
+            stack_pool_thread_free(sp, &threads[i]);
+        }
+    }
+
+    printf("Stack high-water marks (bytes, %d ULTs per function):\n",
+           PROFILE_ULTS);
+    stack_pool_print_profile(sp, stdout);
+
+    stack_pool_destroy(sp);
+    ABT_finalize();
+}
+
+/* sp == NULL: Argobots allocates each stack (ABT_thread_attr_set_stacksize) */
+void create_many(const char *name, stack_pool_t *sp, ABT_pool pool,
+                 ABT_thread *threads, task_arg_t *args, int num_ults,
+                 size_t stack_size)
+{
+    ABT_thread_attr attr = ABT_THREAD_ATTR_NULL;
+    size_t resident = resident_bytes();
+    size_t mapped = sp ? stack_pool_mapped(sp) : 0;
+
+    if (!sp) {
+        ABT_thread_attr_create(&attr);
+        ABT_thread_attr_set_stacksize(attr, stack_size);
+    }
+
+    /* The primary ULT does not yield here: every ULT is alive at once */
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_ults; i++) {
+        if (sp) {
+            stack_pool_thread_create(sp, pool, simple_func, &args[i],
+                                     stack_size, "simple_func", &threads[i]);
+        } else {
+            ABT_thread_create(pool, simple_func, &args[i], attr, &threads[i]);
+        }
+    }
+    double create_time = ABT_get_wtime() - start_time;
+    size_t now = resident_bytes();
+    size_t alive = now > resident ? now - resident : 0;
+
+    start_time = ABT_get_wtime();
+    for (int i = 0; i < num_ults; i++) {
+        if (sp)
+            stack_pool_thread_free(sp, &threads[i]);
+        else
+            ABT_thread_free(&threads[i]);
+    }
+    double free_time = ABT_get_wtime() - start_time;
+
+    if (!sp)
+        ABT_thread_attr_free(&attr);
+
+    printf("%-16s %12.0f %12.0f %14.1f %14.1f\n", name,
+           num_ults / create_time, num_ults / free_time,
+           alive / (1024.0 * 1024.0),
+           sp ? (stack_pool_mapped(sp) - mapped) / (1024.0 * 1024.0) : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    int num_ults = NUM_ULTS;
+    size_t stack_size = STACK_SIZE;
+    int flags = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:gH")) != -1) {
+        switch (opt) {
+            case 'n': num_ults = atoi(optarg); break;
+            case 's': stack_size = (size_t)atol(optarg); break;
+            case 'g': flags |= STACK_POOL_GUARD; break;
+            case 'H': flags |= STACK_POOL_HUGEPAGES; break;
+            default:
+                fprintf(stderr, "Usage: %s [-n ults] [-s stack_bytes] "
+                        "[-g] [-H]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_ults < 1 || stack_pool_class(stack_size) < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+    if ((flags & STACK_POOL_GUARD) && (flags & STACK_POOL_HUGEPAGES)) {
+        fprintf(stderr, "Error: -g and -H cannot be combined\n");
+        return 1;
+    }
+
+    printf("=== Stack Pool Example ===\n\n");
+    profile_functions();
+
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_ults);
+    task_arg_t *args = malloc(sizeof(task_arg_t) * num_ults);
+    for (int i = 0; i < num_ults; i++) {
+        args[i].task_id = i;
+        args[i].value = 10 + i % 100;
+    }
+
+    printf("\n%d ULTs alive at once, %zu-byte stacks%s%s\n", num_ults,
+           stack_size, (flags & STACK_POOL_GUARD) ? ", guard pages" : "",
+           (flags & STACK_POOL_HUGEPAGES) ? ", huge pages" : "");
+    printf("%-16s %12s %12s %14s %14s\n", "stacks", "create/s", "free/s",
+           "resident(MB)", "mapped(MB)");
+
+    ABT_xstream xstream;
+    ABT_pool pool;
+    stack_pool_t *sp;
+
+    ABT_init(0, NULL);
+    ABT_xstream_self(&xstream);
+    ABT_xstream_get_main_pools(xstream, 1, &pool);
+    create_many("argobots", NULL, pool, threads, args, num_ults, stack_size);
+    ABT_finalize();
+
+    ABT_init(0, NULL);
+    ABT_xstream_self(&xstream);
+    ABT_xstream_get_main_pools(xstream, 1, &pool);
+    stack_pool_create(flags, &sp);
+    create_many("pool (1st run)", sp, pool, threads, args, num_ults,
+                stack_size);
+    create_many("pool (reused)", sp, pool, threads, args, num_ults,
+                stack_size);
+    stack_pool_destroy(sp);
+    ABT_finalize();
+
+    printf("\nresident: memory gained while the ULTs were alive\n");
+    printf("mapped: stack chunks the pool had to map during the run\n");
+
+    free(args);
+    free(threads);
+    return 0;
+}
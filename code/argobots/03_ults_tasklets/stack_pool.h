@@ -0,0 +1,434 @@
+/*
+ * ULT stack pool: size-class stack allocator for user-provided ULT stacks
+ *
+ * Stacks are carved out of 2MB mmap'ed chunks and handed to Argobots with
+ * ABT_thread_attr_set_stack(). Requested sizes are rounded up to a power
+ * of two between 4KB and 1MB (the size classes). Freed stacks go to a
+ * per-xstream free list, so creating and freeing ULTs on the same xstream
+ * takes no lock; the lists exchange stacks with a global, locked list in
+ * batches of STACK_POOL_BATCH.
+ *
+ * Flags given to stack_pool_create():
+ *   STACK_POOL_GUARD:     a PROT_NONE page below each stack, so an overflow
+ *                         faults instead of corrupting the neighbor stack
+ *   STACK_POOL_HUGEPAGES: back the chunks with 2MB pages (MAP_HUGETLB, or
+ *                         transparent huge pages if none are reserved);
+ *                         cannot be combined with STACK_POOL_GUARD
+ *   STACK_POOL_PAINT:     fill each stack with a pattern before the ULT runs
+ *                         and measure how much of it was overwritten when the
+ *                         ULT is freed; stack_pool_print_profile() reports
+ *                         the high-water mark of each ULT function
+ *
+ * A stack can only be reused once its ULT has terminated, so ULTs created
+ * with stack_pool_thread_create() must be freed with stack_pool_thread_free().
+ */
+
+#ifndef STACK_POOL_H
+#define STACK_POOL_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <abt.h>
+
+#define STACK_POOL_GUARD 0x1
+#define STACK_POOL_HUGEPAGES 0x2
+#define STACK_POOL_PAINT 0x4
+
+#define STACK_POOL_MIN_SIZE 4096
+#define STACK_POOL_NUM_CLASSES 9       /* 4KB, 8KB, ..., 1MB */
+#define STACK_POOL_CHUNK (2 * 1024 * 1024)
+#define STACK_POOL_MAX_XSTREAMS 64     /* xstreams with a local free list */
+#define STACK_POOL_BATCH 32            /* stacks moved to/from the global list */
+#define STACK_POOL_CACHE_MAX 128       /* per class, before spilling a batch */
+#define STACK_POOL_MAX_PROFILES 64
+#define STACK_POOL_PAINT_WORD 0xA5A5A5A5A5A5A5A5ULL
+
+/* Kept outside of the stack, so painting and measuring never touch it */
+typedef struct stack_desc {
+    struct stack_desc *next;
+    char *base;                /* lowest address; the ULT starts at base + size */
+    size_t size;
+    size_t dirty;              /* bytes at the top that need repainting */
+    int cls;
+    void (*func)(void *);      /* the ULT function and its argument */
+    void *arg;
+    const char *name;
+} stack_desc_t;
+
+typedef struct stack_chunk {
+    struct stack_chunk *next;
+    void *addr;
+    size_t len;
+    stack_desc_t descs[];
+} stack_chunk_t;
+
+typedef struct {
+    _Alignas(64) stack_desc_t *free[STACK_POOL_NUM_CLASSES];
+    int count[STACK_POOL_NUM_CLASSES];
+    ABT_thread_attr attr;      /* reused for every ULT created on the xstream */
+} stack_cache_t;
+
+typedef struct {
+    void (*func)(void *);
+    const char *name;
+    long count;
+    size_t stack_size;         /* largest stack given to this function */
+    size_t max_used;
+    double total_used;
+} stack_profile_t;
+
+typedef struct {
+    int flags;
+    size_t page_size;
+    atomic_flag lock;          /* protects everything below */
+    stack_desc_t *free[STACK_POOL_NUM_CLASSES];
+    stack_chunk_t *chunks;
+    size_t mapped;             /* bytes of address space in chunks */
+    long num_stacks;
+    stack_profile_t profiles[STACK_POOL_MAX_PROFILES];
+    int num_profiles;
+    stack_cache_t caches[STACK_POOL_MAX_XSTREAMS];
+} stack_pool_t;
+
+/* Size class holding size bytes, -1 if larger than the largest class */
+static inline int stack_pool_class(size_t size)
+{
+    int cls = 0;
+    while (((size_t)STACK_POOL_MIN_SIZE << cls) < size) {
+        if (++cls == STACK_POOL_NUM_CLASSES)
+            return -1;
+    }
+    return cls;
+}
+
+static inline void stack_pool_lock(stack_pool_t *sp)
+{
+    while (atomic_flag_test_and_set_explicit(&sp->lock, memory_order_acquire))
+        ;
+}
+
+static inline void stack_pool_unlock(stack_pool_t *sp)
+{
+    atomic_flag_clear_explicit(&sp->lock, memory_order_release);
+}
+
+/* Free list of the calling xstream, NULL outside of an xstream */
+static inline stack_cache_t *stack_pool_cache(stack_pool_t *sp)
+{
+    int rank;
+    if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS || rank < 0 ||
+        rank >= STACK_POOL_MAX_XSTREAMS)
+        return NULL;
+    return &sp->caches[rank];
+}
+
+/* Map a chunk and add its stacks to the global list; called locked */
+static inline int stack_pool_carve(stack_pool_t *sp, int cls)
+{
+    size_t size = (size_t)STACK_POOL_MIN_SIZE << cls;
+    size_t guard = (sp->flags & STACK_POOL_GUARD) ? sp->page_size : 0;
+    size_t slot = guard + size;
+    size_t len = STACK_POOL_CHUNK;
+    size_t num = len / slot;
+    void *addr = MAP_FAILED;
+
+    if (sp->flags & STACK_POOL_HUGEPAGES) {
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (addr == MAP_FAILED) {
+            /* No reserved huge pages: ask for transparent ones instead */
+            addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr != MAP_FAILED)
+                madvise(addr, len, MADV_HUGEPAGE);
+        }
+    } else {
+        /* Pages are only backed once a ULT touches them */
+        addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    }
+    if (addr == MAP_FAILED)
+        return ABT_ERR_MEM;
+
+    stack_chunk_t *chunk = (stack_chunk_t *)malloc(sizeof(stack_chunk_t) +
+                                                   sizeof(stack_desc_t) * num);
+    if (!chunk) {
+        munmap(addr, len);
+        return ABT_ERR_MEM;
+    }
+    chunk->addr = addr;
+    chunk->len = len;
+    for (size_t i = 0; i < num; i++) {
+        stack_desc_t *desc = &chunk->descs[i];
+        char *slot_addr = (char *)addr + i * slot;
+        if (guard)
+            mprotect(slot_addr, guard, PROT_NONE);
+        desc->base = slot_addr + guard;
+        desc->size = size;
+        desc->dirty = size; /* never painted */
+        desc->cls = cls;
+        desc->next = sp->free[cls];
+        sp->free[cls] = desc;
+    }
+    chunk->next = sp->chunks;
+    sp->chunks = chunk;
+    sp->mapped += len;
+    sp->num_stacks += num;
+    return ABT_SUCCESS;
+}
+
+static inline stack_desc_t *stack_pool_get(stack_pool_t *sp,
+                                           stack_cache_t *cache, int cls)
+{
+    stack_desc_t *desc;
+
+    if (!cache || !cache->free[cls]) {
+        stack_pool_lock(sp);
+        if (!sp->free[cls] && stack_pool_carve(sp, cls) != ABT_SUCCESS) {
+            stack_pool_unlock(sp);
+            return NULL;
+        }
+        if (!cache) {
+            desc = sp->free[cls];
+            sp->free[cls] = desc->next;
+            stack_pool_unlock(sp);
+            return desc;
+        }
+        /* Refill the local list with a batch */
+        for (int i = 0; i < STACK_POOL_BATCH && sp->free[cls]; i++) {
+            desc = sp->free[cls];
+            sp->free[cls] = desc->next;
+            desc->next = cache->free[cls];
+            cache->free[cls] = desc;
+            cache->count[cls]++;
+        }
+        stack_pool_unlock(sp);
+    }
+    desc = cache->free[cls];
+    cache->free[cls] = desc->next;
+    cache->count[cls]--;
+    return desc;
+}
+
+static inline void stack_pool_put(stack_pool_t *sp, stack_cache_t *cache,
+                                  stack_desc_t *desc)
+{
+    int cls = desc->cls;
+
+    if (cache) {
+        desc->next = cache->free[cls];
+        cache->free[cls] = desc;
+        if (++cache->count[cls] <= STACK_POOL_CACHE_MAX)
+            return;
+        /* Too many local stacks: give a batch back */
+        stack_pool_lock(sp);
+        for (int i = 0; i < STACK_POOL_BATCH; i++) {
+            desc = cache->free[cls];
+            cache->free[cls] = desc->next;
+            cache->count[cls]--;
+            desc->next = sp->free[cls];
+            sp->free[cls] = desc;
+        }
+        stack_pool_unlock(sp);
+    } else {
+        stack_pool_lock(sp);
+        desc->next = sp->free[cls];
+        sp->free[cls] = desc;
+        stack_pool_unlock(sp);
+    }
+}
+
+/* Bytes of the stack overwritten since it was painted */
+static inline size_t stack_pool_measure(stack_desc_t *desc)
+{
+    const uint64_t *word = (const uint64_t *)desc->base;
+    size_t num_words = desc->size / sizeof(uint64_t), i = 0;
+    /* The stack grows down: untouched paint is at the bottom */
+    while (i < num_words && word[i] == STACK_POOL_PAINT_WORD)
+        i++;
+    return desc->size - i * sizeof(uint64_t);
+}
+
+static inline void stack_pool_record(stack_pool_t *sp, stack_desc_t *desc,
+                                     size_t used)
+{
+    stack_pool_lock(sp);
+    int i = 0;
+    while (i < sp->num_profiles && (sp->profiles[i].func != desc->func ||
+                                    sp->profiles[i].name != desc->name))
+        i++;
+    if (i == sp->num_profiles) {
+        if (i == STACK_POOL_MAX_PROFILES) {
+            stack_pool_unlock(sp);
+            return;
+        }
+        memset(&sp->profiles[i], 0, sizeof(stack_profile_t));
+        sp->profiles[i].func = desc->func;
+        sp->profiles[i].name = desc->name;
+        sp->num_profiles++;
+    }
+    stack_profile_t *prof = &sp->profiles[i];
+    prof->count++;
+    prof->total_used += used;
+    if (used > prof->max_used)
+        prof->max_used = used;
+    if (desc->size > prof->stack_size)
+        prof->stack_size = desc->size;
+    stack_pool_unlock(sp);
+}
+
+/* Body of every ULT created by stack_pool_thread_create() */
+static inline void stack_pool_trampoline(void *arg)
+{
+    stack_desc_t *desc = (stack_desc_t *)arg;
+    desc->func(desc->arg);
+}
+
+static inline int stack_pool_create(int flags, stack_pool_t **newsp)
+{
+    if ((flags & STACK_POOL_GUARD) && (flags & STACK_POOL_HUGEPAGES))
+        return ABT_ERR_INV_ARG; /* a guard page would split the huge page */
+
+    stack_pool_t *sp = (stack_pool_t *)aligned_alloc(64, sizeof(stack_pool_t));
+    if (!sp)
+        return ABT_ERR_MEM;
+    memset(sp, 0, sizeof(stack_pool_t));
+    sp->flags = flags;
+    sp->page_size = (size_t)sysconf(_SC_PAGESIZE);
+    atomic_flag_clear(&sp->lock);
+    for (int i = 0; i < STACK_POOL_MAX_XSTREAMS; i++)
+        sp->caches[i].attr = ABT_THREAD_ATTR_NULL;
+
+    *newsp = sp;
+    return ABT_SUCCESS;
+}
+
+/* Unmap every stack; call before ABT_finalize(), with no ULT left alive */
+static inline void stack_pool_destroy(stack_pool_t *sp)
+{
+    for (int i = 0; i < STACK_POOL_MAX_XSTREAMS; i++) {
+        if (sp->caches[i].attr != ABT_THREAD_ATTR_NULL)
+            ABT_thread_attr_free(&sp->caches[i].attr);
+    }
+    while (sp->chunks) {
+        stack_chunk_t *chunk = sp->chunks;
+        sp->chunks = chunk->next;
+        munmap(chunk->addr, chunk->len);
+        free(chunk);
+    }
+    free(sp);
+}
+
+/*
+ * Create a ULT running func(arg) on a stack of at least stack_size bytes
+ * (at most 1MB). name labels the function in the profile; it must stay
+ * valid until the pool is destroyed.
+ */
+static inline int stack_pool_thread_create(stack_pool_t *sp, ABT_pool pool,
+                                           void (*func)(void *), void *arg,
+                                           size_t stack_size, const char *name,
+                                           ABT_thread *newthread)
+{
+    int cls = stack_pool_class(stack_size);
+    if (cls < 0 || !newthread)
+        return ABT_ERR_INV_ARG;
+
+    stack_cache_t *cache = stack_pool_cache(sp);
+    stack_desc_t *desc = stack_pool_get(sp, cache, cls);
+    if (!desc)
+        return ABT_ERR_MEM;
+    desc->func = func;
+    desc->arg = arg;
+    desc->name = name;
+    if ((sp->flags & STACK_POOL_PAINT) && desc->dirty > 0) {
+        memset(desc->base + desc->size - desc->dirty, 0xA5, desc->dirty);
+        desc->dirty = 0;
+    }
+
+    /* The attribute is copied by ABT_thread_create(), so it can be reused */
+    ABT_thread_attr attr = ABT_THREAD_ATTR_NULL;
+    if (cache) {
+        if (cache->attr == ABT_THREAD_ATTR_NULL)
+            ABT_thread_attr_create(&cache->attr);
+        attr = cache->attr;
+    } else {
+        ABT_thread_attr_create(&attr);
+    }
+    ABT_thread_attr_set_stack(attr, desc->base, desc->size);
+    int ret = ABT_thread_create(pool, stack_pool_trampoline, desc, attr,
+                                newthread);
+    if (!cache)
+        ABT_thread_attr_free(&attr);
+    if (ret != ABT_SUCCESS)
+        stack_pool_put(sp, cache, desc);
+    return ret;
+}
+
+/* Wait for a ULT created by stack_pool_thread_create(), free it and
+ * recycle its stack */
+static inline int stack_pool_thread_free(stack_pool_t *sp, ABT_thread *thread)
+{
+    void (*func)(void *);
+    void *arg;
+
+    if (ABT_thread_get_thread_func(*thread, &func) != ABT_SUCCESS ||
+        func != stack_pool_trampoline)
+        return ABT_ERR_INV_ARG;
+    ABT_thread_get_arg(*thread, &arg);
+    int ret = ABT_thread_free(thread);
+    if (ret != ABT_SUCCESS)
+        return ret;
+
+    stack_desc_t *desc = (stack_desc_t *)arg;
+    if (sp->flags & STACK_POOL_PAINT) {
+        size_t used = stack_pool_measure(desc);
+        desc->dirty = used;
+        stack_pool_record(sp, desc, used);
+    }
+    /* Look up the free list now: ABT_thread_free() may have moved us */
+    stack_pool_put(sp, stack_pool_cache(sp), desc);
+    return ABT_SUCCESS;
+}
+
+static inline size_t stack_pool_mapped(stack_pool_t *sp)
+{
+    stack_pool_lock(sp);
+    size_t mapped = sp->mapped;
+    stack_pool_unlock(sp);
+    return mapped;
+}
+
+/* High-water marks recorded with STACK_POOL_PAINT, with a suggested size
+ * class leaving 25% of headroom */
+static inline void stack_pool_print_profile(stack_pool_t *sp, FILE *out)
+{
+    stack_pool_lock(sp);
+    fprintf(out, "%-20s %8s %10s %10s %10s %10s\n", "function", "ULTs",
+            "stack", "max used", "avg used", "suggested");
+    for (int i = 0; i < sp->num_profiles; i++) {
+        stack_profile_t *prof = &sp->profiles[i];
+        int cls = stack_pool_class(prof->max_used + prof->max_used / 4);
+        char suggested[32];
+        if (prof->max_used >= prof->stack_size)
+            snprintf(suggested, sizeof(suggested), "overflow?");
+        else if (cls < 0)
+            snprintf(suggested, sizeof(suggested), "> 1MB");
+        else
+            snprintf(suggested, sizeof(suggested), "%zu",
+                     (size_t)STACK_POOL_MIN_SIZE << cls);
+        fprintf(out, "%-20s %8ld %10zu %10zu %10.0f %10s\n",
+                prof->name ? prof->name : "?", prof->count, prof->stack_size,
+                prof->max_used, prof->total_used / prof->count, suggested);
+    }
+    stack_pool_unlock(sp);
+}
+
+#endif /* STACK_POOL_H */
@@ -0,0 +1,246 @@
+/*
+ * ULT Pool Example: recycling ULTs with ABT_thread_revive()
+ * Compares ABT_thread_create/ABT_thread_free with a pool of revived ULTs,
+ * then shows the pool growing under a burst and shrinking when idle
+ *
+ * Part 1 runs one driver ULT per xstream. Each driver spawns batch ULTs
+ * in its xstream's pool, joins them, and starts over until it has run its
+ * share of n units. The rate is reported in units/s for each number of
+ * xstreams, next to the 1M units/s target.
+ * Part 2 spawns a burst of ULTs on one xstream, then keeps a few ULTs in
+ * flight and prints how many idle ULTs the pool keeps over time.
+ *
+ * Usage: 03_abt_ult_pool [-x xstreams,...] [-n units] [-b batch]
+ *                        [-t trim_ms]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+#include "ult_pool.h"
+
+#define XSTREAMS "1,2,4"
+#define MAX_XSTREAMS 16
+#define NUM_UNITS 1000000
+#define BATCH 64
+#define TRIM_MS 50
+#define MAX_IDLE 4096
+#define BURST 2000
+#define TARGET_RATE 1e6
+
+typedef struct {
+    int task_id;
+    int value;
+} task_arg_t;
+
+typedef struct {
+    ult_pool_t *up;            /* NULL: ABT_thread_create/ABT_thread_free */
+    ABT_pool pool;
+    long num_units;
+    int batch;
+    task_arg_t *args;
+} driver_arg_t;
+
+volatile int sink;
+
+void simple_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    sink = task->value * task->value;
+}
+
+void driver_func(void *arg)
+{
+    driver_arg_t *d = (driver_arg_t *)arg;
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * d->batch);
+
+    for (long done = 0; done < d->num_units; done += d->batch) {
+        for (int i = 0; i < d->batch; i++) {
+            if (d->up)
+                ult_pool_spawn(d->up, d->pool, simple_func, &d->args[i],
+                               &threads[i]);
+            else
+                ABT_thread_create(d->pool, simple_func, &d->args[i],
+                                  ABT_THREAD_ATTR_NULL, &threads[i]);
+        }
+        for (int i = 0; i < d->batch; i++) {
+            if (d->up)
+                ult_pool_join(d->up, &threads[i]);
+            else
+                ABT_thread_free(&threads[i]);
+        }
+    }
+    free(threads);
+}
+
+/* Units per second with num_xstreams drivers; stats filled if use_pool */
+double run_once(int use_pool, int num_xstreams, long num_units, int batch,
+                ult_pool_stats_t *stats)
+{
+    ABT_xstream xstreams[MAX_XSTREAMS];
+    ABT_pool pools[MAX_XSTREAMS];
+    ABT_thread drivers[MAX_XSTREAMS];
+    driver_arg_t dargs[MAX_XSTREAMS];
+    ult_pool_t *up = NULL;
+
+    ABT_init(0, NULL);
+
+    ABT_xstream_self(&xstreams[0]);
+    ABT_xstream_get_main_pools(xstreams[0], 1, &pools[0]);
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[i]);
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pools[i],
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    if (use_pool)
+        ult_pool_create(MAX_IDLE, 0.0, ABT_THREAD_ATTR_NULL, &up);
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        dargs[i].up = up;
+        dargs[i].pool = pools[i];
+        dargs[i].num_units = num_units / num_xstreams;
+        dargs[i].batch = batch;
+        dargs[i].args = malloc(sizeof(task_arg_t) * batch);
+        for (int j = 0; j < batch; j++) {
+            dargs[i].args[j].task_id = j;
+            dargs[i].args[j].value = 10 + j % 100;
+        }
+        ABT_thread_create(pools[i], driver_func, &dargs[i],
+                          ABT_THREAD_ATTR_NULL, &drivers[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_free(&drivers[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+    long total = (num_units / num_xstreams + batch - 1) / batch * batch *
+                 num_xstreams;
+
+    if (up) {
+        ult_pool_get_stats(up, stats);
+        ult_pool_destroy(up);
+    }
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        free(dargs[i].args);
+    }
+    ABT_finalize();
+    return total / elapsed;
+}
+
+void print_idle(ult_pool_t *up, const char *when, double start_time)
+{
+    ult_pool_stats_t stats;
+    ult_pool_get_stats(up, &stats);
+    printf("%-24s %8.0f %8d %8ld %8ld %8ld\n", when,
+           (ABT_get_wtime() - start_time) * 1e3, stats.idle, stats.created,
+           stats.revived, stats.freed);
+}
+
+void grow_and_shrink(double trim_interval)
+{
+    ABT_xstream xstream;
+    ABT_pool pool;
+    ult_pool_t *up;
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * BURST);
+    task_arg_t arg = {0, 10};
+
+    ABT_init(0, NULL);
+    ABT_xstream_self(&xstream);
+    ABT_xstream_get_main_pools(xstream, 1, &pool);
+    ult_pool_create(MAX_IDLE, trim_interval, ABT_THREAD_ATTR_NULL, &up);
+
+    printf("\n=== Grow and shrink (trim every %.0f ms) ===\n",
+           trim_interval * 1e3);
+    printf("%-24s %8s %8s %8s %8s %8s\n", "phase", "ms", "idle", "created",
+           "revived", "freed");
+    double start_time = ABT_get_wtime();
+
+    /* Burst: all the ULTs are in flight at once, so the pool grows */
+    for (int i = 0; i < BURST; i++)
+        ult_pool_spawn(up, pool, simple_func, &arg, &threads[i]);
+    for (int i = 0; i < BURST; i++)
+        ult_pool_join(up, &threads[i]);
+    print_idle(up, "after burst", start_time);
+
+    /* Light load: 4 ULTs in flight, the rest of the burst stays idle */
+    for (int step = 1; step <= 4; step++) {
+        double until = ABT_get_wtime() + trim_interval;
+        while (ABT_get_wtime() < until) {
+            for (int i = 0; i < 4; i++)
+                ult_pool_spawn(up, pool, simple_func, &arg, &threads[i]);
+            for (int i = 0; i < 4; i++)
+                ult_pool_join(up, &threads[i]);
+        }
+        print_idle(up, "light load", start_time);
+    }
+
+    ult_pool_destroy(up);
+    ABT_finalize();
+    free(threads);
+}
+
+int main(int argc, char **argv)
+{
+    char xstream_list[256] = XSTREAMS;
+    int xstream_counts[MAX_XSTREAMS], num_counts = 0;
+    long num_units = NUM_UNITS;
+    int batch = BATCH;
+    int trim_ms = TRIM_MS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:b:t:")) != -1) {
+        switch (opt) {
+            case 'x':
+                snprintf(xstream_list, sizeof(xstream_list), "%s", optarg);
+                break;
+            case 'n': num_units = atol(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            case 't': trim_ms = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams,...] [-n units] "
+                        "[-b batch] [-t trim_ms]\n", argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(xstream_list, ",");
+         tok && num_counts < MAX_XSTREAMS; tok = strtok(NULL, ",")) {
+        xstream_counts[num_counts] = atoi(tok);
+        if (xstream_counts[num_counts] < 1 ||
+            xstream_counts[num_counts] > MAX_XSTREAMS) {
+            fprintf(stderr, "Error: xstream counts must be in 1..%d\n",
+                    MAX_XSTREAMS);
+            return 1;
+        }
+        num_counts++;
+    }
+    if (num_units < 1 || batch < 1 || trim_ms < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== ULT Pool Example ===\n");
+    printf("%ld units, %d in flight per xstream\n\n", num_units, batch);
+    printf("%-10s %16s %16s %8s %10s\n", "xstreams", "create/free (/s)",
+           "ult_pool (/s)", "speedup", "revived");
+
+    for (int c = 0; c < num_counts; c++) {
+        ult_pool_stats_t stats;
+        int x = xstream_counts[c];
+        double create_rate = run_once(0, x, num_units, batch, NULL);
+        double pool_rate = run_once(1, x, num_units, batch, &stats);
+        printf("%-10d %16.0f %16.0f %7.2fx %9.1f%%%s\n", x, create_rate,
+               pool_rate, pool_rate / create_rate,
+               100.0 * stats.revived / (stats.created + stats.revived),
+               pool_rate >= TARGET_RATE ? "" : "  (below 1M/s)");
+    }
+
+    grow_and_shrink(trim_ms / 1e3);
+    return 0;
+}
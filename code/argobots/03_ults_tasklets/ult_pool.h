@@ -0,0 +1,361 @@
+/*
+ * ULT pool: recycle terminated ULTs with ABT_thread_revive()
+ *
+ * ult_pool_spawn() takes a terminated ULT from the pool and revives it
+ * with a new function and argument, or creates a new ULT when none is
+ * idle, so the pool grows with the number of ULTs in flight.
+ * ult_pool_join() waits for the ULT and gives it back instead of freeing
+ * it. Idle ULTs keep their stack, so a revived ULT costs neither a stack
+ * allocation nor a ULT descriptor allocation.
+ *
+ * Idle ULTs are kept on a per-xstream list, so spawning and joining on
+ * the same xstream takes no lock; the lists exchange ULTs with a global,
+ * locked list in batches of ULT_POOL_BATCH. The pool shrinks on its own:
+ * every trim interval, each list frees as many ULTs as it had idle during
+ * the whole interval (its low-water mark), since those were never needed.
+ * The check runs every ULT_POOL_TRIM_CHECK joins on an xstream, which
+ * trims its own list and the global one; an xstream that stops using the
+ * pool keeps its idle ULTs until it calls ult_pool_trim().
+ *
+ * All the ULTs share the attributes given to ult_pool_create(): a revived
+ * ULT keeps the stack it was created with. ULTs spawned from the pool must
+ * be joined with ult_pool_join(), never freed with ABT_thread_free().
+ */
+
+#ifndef ULT_POOL_H
+#define ULT_POOL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define ULT_POOL_MAX_XSTREAMS 64       /* xstreams with a local idle list */
+#define ULT_POOL_BATCH 32              /* ULTs moved to/from the global list */
+#define ULT_POOL_CACHE_MAX 128         /* per xstream, before spilling a batch */
+#define ULT_POOL_TRIM_CHECK 64         /* operations between clock reads */
+
+typedef struct {
+    _Alignas(64) ABT_thread idle[ULT_POOL_CACHE_MAX];
+    int num_idle;
+    int low_water;             /* fewest idle ULTs since the last trim */
+    int ops;
+    double last_trim;
+    long created;
+    long revived;
+    long freed;
+} ult_pool_cache_t;
+
+typedef struct {
+    double trim_interval;      /* seconds; 0 never trims */
+    ABT_thread_attr attr;      /* used to create every ULT */
+    atomic_flag lock;          /* protects everything down to caches */
+    ABT_thread *idle;          /* global idle list */
+    int num_idle;
+    int max_idle;
+    int low_water;
+    double last_trim;
+    long created;              /* by callers outside of an xstream */
+    long revived;
+    long freed;
+    ult_pool_cache_t caches[ULT_POOL_MAX_XSTREAMS];
+} ult_pool_t;
+
+typedef struct {
+    long created;              /* ULTs created because none was idle */
+    long revived;              /* ULTs reused */
+    long freed;                /* idle ULTs freed by trimming or overflow */
+    int idle;                  /* ULTs currently waiting to be reused */
+} ult_pool_stats_t;
+
+static inline void ult_pool_lock(ult_pool_t *up)
+{
+    while (atomic_flag_test_and_set_explicit(&up->lock, memory_order_acquire))
+        ;
+}
+
+static inline void ult_pool_unlock(ult_pool_t *up)
+{
+    atomic_flag_clear_explicit(&up->lock, memory_order_release);
+}
+
+/* Idle list of the calling xstream, NULL outside of an xstream */
+static inline ult_pool_cache_t *ult_pool_cache(ult_pool_t *up)
+{
+    int rank;
+    if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS || rank < 0 ||
+        rank >= ULT_POOL_MAX_XSTREAMS)
+        return NULL;
+    return &up->caches[rank];
+}
+
+static inline void ult_pool_free_all(ABT_thread *threads, int num)
+{
+    for (int i = 0; i < num; i++)
+        ABT_thread_free(&threads[i]);
+}
+
+/* Take the ULTs of the global list that stayed idle for a whole interval,
+ * oldest first, at most max at a time; called locked */
+static inline int ult_pool_trim_global(ult_pool_t *up, double now,
+                                       ABT_thread *trimmed, int max)
+{
+    if (up->trim_interval <= 0 || now - up->last_trim < up->trim_interval)
+        return 0;
+    int num = up->low_water < max ? up->low_water : max;
+    memcpy(trimmed, up->idle, sizeof(ABT_thread) * num);
+    up->num_idle -= num;
+    memmove(up->idle, &up->idle[num], sizeof(ABT_thread) * up->num_idle);
+    up->freed += num;
+    up->low_water -= num;
+    if (up->low_water == 0) {
+        /* Done: start the next interval */
+        up->low_water = up->num_idle;
+        up->last_trim = now;
+    }
+    return num;
+}
+
+static inline void ult_pool_trim_cache(ult_pool_t *up, ult_pool_cache_t *cache,
+                                       double now)
+{
+    if (up->trim_interval <= 0 || now - cache->last_trim < up->trim_interval)
+        return;
+    int num = cache->low_water;
+    ult_pool_free_all(cache->idle, num);
+    cache->num_idle -= num;
+    memmove(cache->idle, &cache->idle[num], sizeof(ABT_thread) * cache->num_idle);
+    cache->freed += num;
+    cache->low_water = cache->num_idle;
+    cache->last_trim = now;
+}
+
+/* Move a batch from the global list to the local one; 0 if it is empty */
+static inline int ult_pool_refill(ult_pool_t *up, ult_pool_cache_t *cache)
+{
+    ABT_thread trimmed[ULT_POOL_BATCH];
+    int num_trimmed;
+
+    ult_pool_lock(up);
+    num_trimmed = ult_pool_trim_global(up, ABT_get_wtime(), trimmed,
+                                       ULT_POOL_BATCH);
+    int num = up->num_idle < ULT_POOL_BATCH ? up->num_idle : ULT_POOL_BATCH;
+    up->num_idle -= num;
+    memcpy(cache->idle, &up->idle[up->num_idle], sizeof(ABT_thread) * num);
+    if (up->num_idle < up->low_water)
+        up->low_water = up->num_idle;
+    ult_pool_unlock(up);
+
+    ult_pool_free_all(trimmed, num_trimmed);
+    cache->num_idle = num;
+    return num;
+}
+
+/* Move the oldest batch of the local list to the global one, and free
+ * what does not fit there */
+static inline void ult_pool_spill(ult_pool_t *up, ult_pool_cache_t *cache)
+{
+    ABT_thread trimmed[ULT_POOL_BATCH];
+    int num_trimmed, num_kept;
+
+    ult_pool_lock(up);
+    num_trimmed = ult_pool_trim_global(up, ABT_get_wtime(), trimmed,
+                                       ULT_POOL_BATCH);
+    num_kept = up->max_idle - up->num_idle;
+    if (num_kept > ULT_POOL_BATCH)
+        num_kept = ULT_POOL_BATCH;
+    memcpy(&up->idle[up->num_idle], cache->idle, sizeof(ABT_thread) * num_kept);
+    up->num_idle += num_kept;
+    up->freed += ULT_POOL_BATCH - num_kept;
+    ult_pool_unlock(up);
+
+    ult_pool_free_all(trimmed, num_trimmed);
+    ult_pool_free_all(&cache->idle[num_kept], ULT_POOL_BATCH - num_kept);
+    cache->num_idle -= ULT_POOL_BATCH;
+    memmove(cache->idle, &cache->idle[ULT_POOL_BATCH],
+            sizeof(ABT_thread) * cache->num_idle);
+    if (cache->num_idle < cache->low_water)
+        cache->low_water = cache->num_idle;
+}
+
+/* Trim the idle list of the calling xstream and the global one now, if
+ * their interval has elapsed */
+static inline void ult_pool_trim(ult_pool_t *up)
+{
+    ABT_thread trimmed[ULT_POOL_BATCH];
+    double now = ABT_get_wtime();
+    ult_pool_cache_t *cache = ult_pool_cache(up);
+    int num_trimmed;
+
+    if (cache)
+        ult_pool_trim_cache(up, cache, now);
+    do {
+        ult_pool_lock(up);
+        num_trimmed = ult_pool_trim_global(up, now, trimmed, ULT_POOL_BATCH);
+        ult_pool_unlock(up);
+        ult_pool_free_all(trimmed, num_trimmed);
+    } while (num_trimmed == ULT_POOL_BATCH);
+}
+
+/* Take an idle ULT, ABT_THREAD_NULL if there is none */
+static inline ABT_thread ult_pool_get(ult_pool_t *up, ult_pool_cache_t *cache)
+{
+    ABT_thread thread = ABT_THREAD_NULL;
+
+    if (!cache) {
+        ult_pool_lock(up);
+        if (up->num_idle > 0) {
+            thread = up->idle[--up->num_idle];
+            if (up->num_idle < up->low_water)
+                up->low_water = up->num_idle;
+        }
+        ult_pool_unlock(up);
+        return thread;
+    }
+    if (cache->num_idle == 0 && ult_pool_refill(up, cache) == 0)
+        return ABT_THREAD_NULL;
+    /* Most recently joined first: its stack is still in the cache */
+    thread = cache->idle[--cache->num_idle];
+    if (cache->num_idle < cache->low_water)
+        cache->low_water = cache->num_idle;
+    return thread;
+}
+
+static inline void ult_pool_put(ult_pool_t *up, ult_pool_cache_t *cache,
+                                ABT_thread thread)
+{
+    if (!cache) {
+        ult_pool_lock(up);
+        if (up->num_idle < up->max_idle) {
+            up->idle[up->num_idle++] = thread;
+            thread = ABT_THREAD_NULL;
+        } else {
+            up->freed++;
+        }
+        ult_pool_unlock(up);
+        if (thread != ABT_THREAD_NULL)
+            ABT_thread_free(&thread);
+        return;
+    }
+    if (cache->num_idle == ULT_POOL_CACHE_MAX)
+        ult_pool_spill(up, cache);
+    cache->idle[cache->num_idle++] = thread;
+    if (++cache->ops == ULT_POOL_TRIM_CHECK) {
+        cache->ops = 0;
+        ult_pool_trim(up);
+    }
+}
+
+/*
+ * Create a pool keeping at most max_idle ULTs on the global list (plus up
+ * to ULT_POOL_CACHE_MAX per xstream). ULTs idle for trim_interval seconds
+ * are freed; 0 keeps them until the pool is destroyed. attr may be
+ * ABT_THREAD_ATTR_NULL; it must stay valid until the pool is destroyed.
+ */
+static inline int ult_pool_create(int max_idle, double trim_interval,
+                                  ABT_thread_attr attr, ult_pool_t **newup)
+{
+    if (max_idle < 0 || trim_interval < 0)
+        return ABT_ERR_INV_ARG;
+
+    ult_pool_t *up = (ult_pool_t *)aligned_alloc(64, sizeof(ult_pool_t));
+    if (!up)
+        return ABT_ERR_MEM;
+    memset(up, 0, sizeof(ult_pool_t));
+    up->idle = (ABT_thread *)malloc(sizeof(ABT_thread) * (max_idle + 1));
+    if (!up->idle) {
+        free(up);
+        return ABT_ERR_MEM;
+    }
+    up->max_idle = max_idle;
+    up->trim_interval = trim_interval;
+    up->attr = attr;
+    atomic_flag_clear(&up->lock);
+    up->last_trim = ABT_get_wtime();
+    for (int i = 0; i < ULT_POOL_MAX_XSTREAMS; i++)
+        up->caches[i].last_trim = up->last_trim;
+
+    *newup = up;
+    return ABT_SUCCESS;
+}
+
+/* Free every idle ULT; call with every spawned ULT joined */
+static inline void ult_pool_destroy(ult_pool_t *up)
+{
+    for (int i = 0; i < ULT_POOL_MAX_XSTREAMS; i++)
+        ult_pool_free_all(up->caches[i].idle, up->caches[i].num_idle);
+    ult_pool_free_all(up->idle, up->num_idle);
+    free(up->idle);
+    free(up);
+}
+
+/* Run func(arg) in pool on an idle ULT, or on a new one if none is idle */
+static inline int ult_pool_spawn(ult_pool_t *up, ABT_pool pool,
+                                 void (*func)(void *), void *arg,
+                                 ABT_thread *newthread)
+{
+    if (!newthread)
+        return ABT_ERR_INV_ARG;
+
+    ult_pool_cache_t *cache = ult_pool_cache(up);
+    ABT_thread thread = ult_pool_get(up, cache);
+    if (thread != ABT_THREAD_NULL) {
+        int ret = ABT_thread_revive(pool, func, arg, &thread);
+        if (ret != ABT_SUCCESS) {
+            ult_pool_put(up, cache, thread);
+            return ret;
+        }
+        if (cache) {
+            cache->revived++;
+        } else {
+            ult_pool_lock(up);
+            up->revived++;
+            ult_pool_unlock(up);
+        }
+    } else {
+        int ret = ABT_thread_create(pool, func, arg, up->attr, &thread);
+        if (ret != ABT_SUCCESS)
+            return ret;
+        if (cache) {
+            cache->created++;
+        } else {
+            ult_pool_lock(up);
+            up->created++;
+            ult_pool_unlock(up);
+        }
+    }
+    *newthread = thread;
+    return ABT_SUCCESS;
+}
+
+/* Wait for a ULT spawned by ult_pool_spawn() and keep it for reuse */
+static inline int ult_pool_join(ult_pool_t *up, ABT_thread *thread)
+{
+    int ret = ABT_thread_join(*thread);
+    if (ret != ABT_SUCCESS)
+        return ret;
+    /* Look up the idle list now: the join may have moved us */
+    ult_pool_put(up, ult_pool_cache(up), *thread);
+    *thread = ABT_THREAD_NULL;
+    return ABT_SUCCESS;
+}
+
+/* Counters are summed without stopping the xstreams: call when the pool is
+ * quiet for exact numbers */
+static inline void ult_pool_get_stats(ult_pool_t *up, ult_pool_stats_t *stats)
+{
+    ult_pool_lock(up);
+    stats->created = up->created;
+    stats->revived = up->revived;
+    stats->freed = up->freed;
+    stats->idle = up->num_idle;
+    ult_pool_unlock(up);
+    for (int i = 0; i < ULT_POOL_MAX_XSTREAMS; i++) {
+        stats->created += up->caches[i].created;
+        stats->revived += up->caches[i].revived;
+        stats->freed += up->caches[i].freed;
+        stats->idle += up->caches[i].num_idle;
+    }
+}
+
+#endif /* ULT_POOL_H */
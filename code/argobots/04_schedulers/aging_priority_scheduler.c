@@ -0,0 +1,462 @@
+/*
+ * Multi-level priority scheduler with weighted fair shares or aging
+ * Records a queueing-delay histogram per priority class
+ *
+ * ABT_SCHED_PRIO drains higher-priority pools first, so a steady stream of
+ * high-priority work starves the lower classes. This scheduler keeps one
+ * pool per class and supports two policies:
+ *   weighted: stride scheduling; class c gets a share of the xstream
+ *             proportional to its weight while it has work
+ *   aging:    strict priority, except that a non-empty class that has not
+ *             been served for aging_ms is served next
+ * Every xstream serves the same class pools, so the schedulers share the
+ * policy state (prio_shared_t): a class served by any xstream is not
+ * starving, and the weights apply to the xstreams together.
+ * The benchmark runs foreground RPCs at a rate that keeps the xstreams busy,
+ * some I/O, and a backlog of background compaction ULTs, under PRIO and
+ * under both policies.
+ *
+ * Usage: 04_abt_aging_priority_scheduler [-x xstreams] [-t duration_ms]
+ *                                        [-w work_us] [-l rpc_load]
+ *                                        [-W w0,w1,w2] [-a aging_ms]
+ *                                        [-b background_ults]
+ *   rpc_load is the RPC arrival rate as a fraction of the xstreams' capacity
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 2
+#define NUM_CLASSES 3
+#define DURATION_MS 1000
+#define WORK_US 50
+#define RPC_LOAD 0.95
+#define IO_LOAD 0.05
+#define WEIGHTS "8,3,1"
+#define AGING_MS 10
+#define NUM_BACKGROUND 200
+#define EVENT_FREQ 64
+#define HIST_BUCKETS 25        /* bucket b: delays in [2^(b-1), 2^b) us */
+
+enum { POLICY_WEIGHTED, POLICY_AGING };
+
+/* Shared by the schedulers of all the xstreams */
+typedef struct {
+    int num_classes;
+    atomic_flag lock;          /* weighted: protects pass and vtime */
+    double *stride;            /* weighted: 1 / weight */
+    double *pass;              /* weighted: virtual time of each class */
+    double vtime;
+    _Atomic double *last_served;  /* aging: when each class last ran */
+} prio_shared_t;
+
+typedef struct {
+    int event_freq;
+    int policy;
+    double aging_time;
+    int num_pools;             /* one pool per class, highest priority first */
+    ABT_pool *pools;
+    prio_shared_t *shared;
+} sched_data_t;
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_policy = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_aging_time = {
+    .idx = 2,
+    .type = ABT_SCHED_CONFIG_DOUBLE
+};
+
+static ABT_sched_config_var cv_shared = {
+    .idx = 3,
+    .type = ABT_SCHED_CONFIG_PTR
+};
+
+/* weights[i]: share of class i under the weighted policy */
+prio_shared_t *prio_shared_create(int num_classes, const int *weights)
+{
+    prio_shared_t *shared = (prio_shared_t *)calloc(1, sizeof(prio_shared_t));
+    shared->num_classes = num_classes;
+    atomic_flag_clear(&shared->lock);
+    shared->stride = (double *)malloc(sizeof(double) * num_classes);
+    shared->pass = (double *)calloc(num_classes, sizeof(double));
+    shared->last_served = malloc(sizeof(_Atomic double) * num_classes);
+    double now = ABT_get_wtime();
+    for (int i = 0; i < num_classes; i++) {
+        shared->stride[i] = 1.0 / (weights[i] > 0 ? weights[i] : 1);
+        atomic_init(&shared->last_served[i], now);
+    }
+    return shared;
+}
+
+/* Once the xstreams using it are freed */
+void prio_shared_free(prio_shared_t *shared)
+{
+    free(shared->last_served);
+    free(shared->pass);
+    free(shared->stride);
+    free(shared);
+}
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 4, &data->event_freq, &data->policy,
+                          &data->aging_time, &data->shared);
+    ABT_sched_get_num_pools(sched, &data->num_pools);
+    data->pools = (ABT_pool *)malloc(sizeof(ABT_pool) * data->num_pools);
+    ABT_sched_get_pools(sched, data->num_pools, 0, data->pools);
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+/* Index of the class to serve next, or -1 if every pool is empty */
+static int pick_class(sched_data_t *data)
+{
+    prio_shared_t *shared = data->shared;
+    int pick = -1;
+    size_t size;
+
+    if (data->policy == POLICY_AGING) {
+        double now = ABT_get_wtime();
+        double oldest = now - data->aging_time;
+        for (int i = 0; i < data->num_pools; i++) {
+            ABT_pool_get_size(data->pools[i], &size);
+            if (size == 0) {
+                /* An empty class is not waiting for anything */
+                atomic_store_explicit(&shared->last_served[i], now,
+                                      memory_order_relaxed);
+                continue;
+            }
+            if (pick < 0)
+                pick = i; /* highest non-empty priority */
+            double last = atomic_load_explicit(&shared->last_served[i],
+                                               memory_order_relaxed);
+            if (last < oldest) {
+                oldest = last;
+                pick = i; /* starving for longer than aging_time */
+            }
+        }
+    } else {
+        while (atomic_flag_test_and_set_explicit(&shared->lock,
+                                                 memory_order_acquire))
+            ;
+        for (int i = 0; i < data->num_pools; i++) {
+            ABT_pool_get_size(data->pools[i], &size);
+            if (size == 0) {
+                /* Idle classes do not accumulate credit */
+                if (shared->pass[i] < shared->vtime)
+                    shared->pass[i] = shared->vtime;
+                continue;
+            }
+            if (pick < 0 || shared->pass[i] < shared->pass[pick])
+                pick = i;
+        }
+        if (pick >= 0) {
+            shared->vtime = shared->pass[pick];
+            shared->pass[pick] += shared->stride[pick];
+        }
+        atomic_flag_clear_explicit(&shared->lock, memory_order_release);
+    }
+    return pick;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int work_count = 0;
+
+    ABT_sched_get_data(sched, (void **)&data);
+
+    while (1) {
+        int c = pick_class(data);
+        if (c >= 0) {
+            ABT_thread thread;
+            ABT_pool_pop_thread(data->pools[c], &thread);
+            if (thread != ABT_THREAD_NULL) {
+                atomic_store_explicit(&data->shared->last_served[c],
+                                      ABT_get_wtime(), memory_order_relaxed);
+                ABT_self_schedule(thread, ABT_POOL_NULL);
+            }
+        }
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data->pools);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/* pools[i] holds class i, class 0 has the highest priority; every
+ * scheduler serving these pools gets the same shared state */
+int aging_prio_sched_create(int num_pools, ABT_pool *pools, int policy,
+                            prio_shared_t *shared, double aging_time,
+                            ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_policy, policy, cv_aging_time, aging_time,
+                            cv_shared, shared,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, num_pools, pools, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Benchmark ---- */
+
+const char *class_names[NUM_CLASSES] = {"rpc", "io", "compaction"};
+
+typedef struct {
+    int cls;
+    double enqueue_time;
+} request_t;
+
+_Atomic long histogram[NUM_CLASSES][HIST_BUCKETS];
+double work_time;
+
+int delay_bucket(double delay)
+{
+    long us = (long)(delay * 1e6);
+    int b = 0;
+    while (us > 0 && b < HIST_BUCKETS - 1) {
+        us >>= 1;
+        b++;
+    }
+    return b;
+}
+
+void request_func(void *arg)
+{
+    request_t *req = (request_t *)arg;
+    double start = ABT_get_wtime();
+    atomic_fetch_add_explicit(
+        &histogram[req->cls][delay_bucket(start - req->enqueue_time)], 1,
+        memory_order_relaxed);
+    while (ABT_get_wtime() - start < work_time)
+        ;
+}
+
+/* Upper bound of the bucket holding the q-quantile, in microseconds */
+long hist_quantile(int cls, long total, double q)
+{
+    long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        seen += histogram[cls][b];
+        if (seen > 0 && seen >= q * total)
+            return 1L << b;
+    }
+    return 1L << (HIST_BUCKETS - 1);
+}
+
+void print_histogram(void)
+{
+    long totals[NUM_CLASSES] = {0};
+
+    printf("  %-14s", "delay(us)");
+    for (int c = 0; c < NUM_CLASSES; c++)
+        printf(" %11s", class_names[c]);
+    printf("\n");
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+        long row = 0;
+        for (int c = 0; c < NUM_CLASSES; c++)
+            row += histogram[c][b];
+        for (int c = 0; c < NUM_CLASSES; c++)
+            totals[c] += histogram[c][b];
+        if (row == 0)
+            continue;
+        char range[32];
+        if (b == 0)
+            snprintf(range, sizeof(range), "< 1");
+        else
+            snprintf(range, sizeof(range), "%ld - %ld", 1L << (b - 1), 1L << b);
+        printf("  %-14s", range);
+        for (int c = 0; c < NUM_CLASSES; c++)
+            printf(" %11ld", (long)histogram[c][b]);
+        printf("\n");
+    }
+    printf("  %-14s", "p50 <=");
+    for (int c = 0; c < NUM_CLASSES; c++)
+        printf(" %11ld", hist_quantile(c, totals[c], 0.5));
+    printf("\n  %-14s", "p99 <=");
+    for (int c = 0; c < NUM_CLASSES; c++)
+        printf(" %11ld", hist_quantile(c, totals[c], 0.99));
+    printf("\n");
+}
+
+/* policy < 0 selects the predefined ABT_SCHED_PRIO */
+void run_policy(const char *name, int policy, int num_xstreams,
+                double duration, double rpc_load, int *weights,
+                double aging_time, int num_background)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool pools[NUM_CLASSES];
+    double capacity = num_xstreams / work_time; /* requests per second */
+    double rates[2] = {rpc_load * capacity, IO_LOAD * capacity};
+    int max_requests = (int)((rates[0] + rates[1]) * duration) +
+                       num_background + 2;
+    request_t *requests = malloc(sizeof(request_t) * max_requests);
+    int num_requests = 0;
+
+    memset(histogram, 0, sizeof(histogram));
+    ABT_init(0, NULL);
+    prio_shared_t *shared = prio_shared_create(NUM_CLASSES, weights);
+
+    for (int c = 0; c < NUM_CLASSES; c++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[c]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_sched sched;
+        if (policy < 0) {
+            ABT_sched_create_basic(ABT_SCHED_PRIO, NUM_CLASSES, pools,
+                                   ABT_SCHED_CONFIG_NULL, &sched);
+        } else {
+            aging_prio_sched_create(NUM_CLASSES, pools, policy, shared,
+                                    aging_time, &sched);
+        }
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+
+    /* Background compaction work is queued up front */
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_background; i++) {
+        request_t *req = &requests[num_requests++];
+        req->cls = 2;
+        req->enqueue_time = start_time;
+        ABT_thread_create(pools[2], request_func, req, ABT_THREAD_ATTR_NULL,
+                          NULL);
+    }
+
+    /* Open-loop RPC and I/O arrivals */
+    double next[2] = {start_time, start_time};
+    while (1) {
+        double now = ABT_get_wtime();
+        if (now - start_time >= duration || num_requests >= max_requests)
+            break;
+        for (int c = 0; c < 2; c++) {
+            if (now >= next[c] && num_requests < max_requests) {
+                request_t *req = &requests[num_requests++];
+                req->cls = c;
+                req->enqueue_time = next[c];
+                ABT_thread_create(pools[c], request_func, req,
+                                  ABT_THREAD_ATTR_NULL, NULL);
+                next[c] += 1.0 / rates[c];
+            }
+        }
+    }
+
+    /* Joining drains whatever is still queued */
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    prio_shared_free(shared);
+    ABT_finalize();
+
+    printf("%s:\n", name);
+    print_histogram();
+    printf("\n");
+
+    free(requests);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int duration_ms = DURATION_MS;
+    int work_us = WORK_US;
+    double rpc_load = RPC_LOAD;
+    char weight_list[64] = WEIGHTS;
+    int weights[NUM_CLASSES];
+    int aging_ms = AGING_MS;
+    int num_background = NUM_BACKGROUND;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:t:w:l:W:a:b:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 't': duration_ms = atoi(optarg); break;
+            case 'w': work_us = atoi(optarg); break;
+            case 'l': rpc_load = atof(optarg); break;
+            case 'W':
+                snprintf(weight_list, sizeof(weight_list), "%s", optarg);
+                break;
+            case 'a': aging_ms = atoi(optarg); break;
+            case 'b': num_background = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-t duration_ms] "
+                        "[-w work_us] [-l rpc_load] [-W w0,w1,w2] "
+                        "[-a aging_ms] [-b background_ults]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (sscanf(weight_list, "%d,%d,%d", &weights[0], &weights[1],
+               &weights[2]) != NUM_CLASSES ||
+        weights[0] < 1 || weights[1] < 1 || weights[2] < 1) {
+        fprintf(stderr, "Error: -W needs %d positive weights\n", NUM_CLASSES);
+        return 1;
+    }
+    if (num_xstreams < 1 || duration_ms < 1 || work_us < 1 || rpc_load <= 0 ||
+        aging_ms < 0 || num_background < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+    work_time = work_us * 1e-6;
+
+    printf("=== Priority Scheduling with Aging ===\n");
+    printf("%d xstreams, %d ms, %d us per ULT; rpc load %.2f, io load %.2f, "
+           "%d compaction ULTs\n", num_xstreams, duration_ms, work_us,
+           rpc_load, IO_LOAD, num_background);
+    printf("Queueing delay histograms (ULTs per delay range)\n\n");
+
+    run_policy("PRIO (strict)", -1, num_xstreams, duration_ms * 1e-3,
+               rpc_load, weights, 0.0, num_background);
+    char name[64];
+    snprintf(name, sizeof(name), "weighted %d:%d:%d", weights[0], weights[1],
+             weights[2]);
+    run_policy(name, POLICY_WEIGHTED, num_xstreams, duration_ms * 1e-3,
+               rpc_load, weights, 0.0, num_background);
+    snprintf(name, sizeof(name), "aging %d ms", aging_ms);
+    run_policy(name, POLICY_AGING, num_xstreams, duration_ms * 1e-3,
+               rpc_load, weights, aging_ms * 1e-3, num_background);
+
+    printf("Under PRIO, compaction only runs once the RPC stream stops\n");
+    return 0;
+}
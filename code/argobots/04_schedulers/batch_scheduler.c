@@ -0,0 +1,262 @@
+/*
+ * Batched scheduler: pop several work units per pool access
+ * Amortizes the pool lock and the event checks over tiny work units
+ *
+ * ABT_SCHED_BASIC pops one work unit at a time. When the work units do
+ * almost nothing, the pop (and its lock on a shared pool) dominates. This
+ * scheduler pulls up to batch_size units with one ABT_pool_pop_threads()
+ * into a local buffer, runs them back to back, and checks events once
+ * per EVENT_FREQ units.
+ *
+ * Usage: 04_abt_batch_scheduler [-x xstreams] [-n units] [-r repeats]
+ *                               [-b batch,...] [-u]
+ *   the benchmark queues n tasklets (ULTs with -u) before the xstreams
+ *   start, and measures how fast they are drained
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 1
+#define NUM_UNITS 100000
+#define REPEATS 3
+#define BATCHES "1,8,32,128"
+#define MAX_BATCHES 16
+#define MAX_BATCH 1024
+#define EVENT_FREQ 64
+
+typedef struct {
+    int event_freq;
+    int batch_size;
+    ABT_pool pool;
+} sched_data_t;
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_batch_size = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 2, &data->event_freq, &data->batch_size);
+    if (data->batch_size < 1)
+        data->batch_size = 1;
+    if (data->batch_size > MAX_BATCH)
+        data->batch_size = MAX_BATCH;
+    ABT_sched_get_pools(sched, 1, 0, &data->pool);
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_thread batch[MAX_BATCH];
+    int work_count = 0;
+
+    ABT_sched_get_data(sched, (void **)&data);
+
+    while (1) {
+        size_t num = 0;
+        ABT_pool_pop_threads(data->pool, batch, data->batch_size, &num);
+        for (size_t i = 0; i < num; i++) {
+            ABT_self_schedule(batch[i], ABT_POOL_NULL);
+        }
+
+        /* An empty pop counts as one unit, so an idle xstream still
+         * checks its events regularly */
+        work_count += num > 0 ? (int)num : 1;
+        if (work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+int batch_sched_create(ABT_pool pool, int batch_size, ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_batch_size, batch_size,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, 1, &pool, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Benchmark ---- */
+
+typedef struct {
+    int task_id;
+    int value;
+} task_arg_t;
+
+volatile int sink;
+
+void empty_func(void *arg)
+{
+}
+
+/* Same computation as simple_func in 03_ults_tasklets, without the printf */
+void near_empty_func(void *arg)
+{
+    task_arg_t *task = (task_arg_t *)arg;
+    sink = task->value * task->value;
+}
+
+/* batch_size 0 selects ABT_SCHED_BASIC; returns units per second */
+double run_once(int batch_size, void (*func)(void *), int use_ults,
+                int num_xstreams, int num_units, task_arg_t *args)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool pool;
+
+    ABT_init(0, NULL);
+
+    ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                          &pool);
+
+    /* Queue the units before any xstream runs them */
+    for (int i = 0; i < num_units; i++) {
+        if (use_ults)
+            ABT_thread_create(pool, func, &args[i], ABT_THREAD_ATTR_NULL, NULL);
+        else
+            ABT_task_create(pool, func, &args[i], NULL);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_sched sched;
+        if (batch_size == 0) {
+            ABT_sched_create_basic(ABT_SCHED_BASIC, 1, &pool,
+                                   ABT_SCHED_CONFIG_NULL, &sched);
+        } else {
+            batch_sched_create(pool, batch_size, &sched);
+        }
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    ABT_finalize();
+    free(xstreams);
+    return num_units / elapsed;
+}
+
+double run_best(int batch_size, void (*func)(void *), int use_ults,
+                int num_xstreams, int num_units, int repeats, task_arg_t *args)
+{
+    double best = 0.0;
+    for (int r = 0; r < repeats; r++) {
+        double rate = run_once(batch_size, func, use_ults, num_xstreams,
+                               num_units, args);
+        if (rate > best)
+            best = rate;
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_units = NUM_UNITS;
+    int repeats = REPEATS;
+    char batch_list[256] = BATCHES;
+    int batches[MAX_BATCHES], num_batches = 0;
+    int use_ults = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:r:b:u")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_units = atoi(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'b':
+                snprintf(batch_list, sizeof(batch_list), "%s", optarg);
+                break;
+            case 'u': use_ults = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n units] "
+                        "[-r repeats] [-b batch,...] [-u]\n", argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(batch_list, ","); tok && num_batches < MAX_BATCHES;
+         tok = strtok(NULL, ",")) {
+        batches[num_batches] = atoi(tok);
+        if (batches[num_batches] < 1 || batches[num_batches] > MAX_BATCH) {
+            fprintf(stderr, "Error: batch sizes must be in 1..%d\n", MAX_BATCH);
+            return 1;
+        }
+        num_batches++;
+    }
+    if (num_xstreams < 1 || num_units < 1 || repeats < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    task_arg_t *args = malloc(sizeof(task_arg_t) * num_units);
+    for (int i = 0; i < num_units; i++) {
+        args[i].task_id = i;
+        args[i].value = 10 + i % 100;
+    }
+
+    printf("=== Batched Pop Scheduler ===\n");
+    printf("%d xstreams, %d %s, best of %d runs\n\n", num_xstreams, num_units,
+           use_ults ? "ULTs" : "tasklets", repeats);
+    printf("%-12s %18s %18s\n", "scheduler", "empty (units/s)",
+           "simple (units/s)");
+
+    printf("%-12s %18.0f %18.0f\n", "BASIC",
+           run_best(0, empty_func, use_ults, num_xstreams, num_units,
+                    repeats, args),
+           run_best(0, near_empty_func, use_ults, num_xstreams, num_units,
+                    repeats, args));
+    for (int b = 0; b < num_batches; b++) {
+        char name[32];
+        snprintf(name, sizeof(name), "batch %d", batches[b]);
+        printf("%-12s %18.0f %18.0f\n", name,
+               run_best(batches[b], empty_func, use_ults, num_xstreams,
+                        num_units, repeats, args),
+               run_best(batches[b], near_empty_func, use_ults, num_xstreams,
+                        num_units, repeats, args));
+    }
+
+    free(args);
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * Chase-Lev work-stealing deque as a user-defined Argobots pool
+ *
+ * Each pool is owned by one execution stream (given by its rank).
+ * - The owner pushes and pops at the bottom of the deque (LIFO): the most
+ *   recently spawned, cache-hot work runs first.
+ * - Other execution streams steal from the top (FIFO): they take the oldest
+ *   work, which in divide-and-conquer algorithms is the largest subtree.
+ * Neither operation takes a lock. Pushes from other execution streams (for
+ * instance a ULT resumed by a thief after a join) and pushes that do not fit
+ * in the deque go to a small lock-protected inbox instead.
+ *
+ * Based on "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013).
+ */
+
+#ifndef CHASE_LEV_POOL_H
+#define CHASE_LEV_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define CHASE_LEV_CAPACITY (1 << 14) /* deque slots, must be a power of 2 */
+#define CHASE_LEV_OWNER_KEY 1        /* pool config key holding the owner rank */
+
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;    /* next slot thieves steal from */
+    _Alignas(64) _Atomic int64_t bottom; /* next slot the owner pushes to */
+    _Alignas(64) _Atomic(ABT_unit) *buffer;
+    int64_t mask;
+    int owner_rank;
+    /* Inbox for non-owner pushes and overflow (FIFO ring, grows on demand) */
+    atomic_flag inbox_lock;
+    ABT_unit *inbox;
+    size_t inbox_head;
+    size_t inbox_capacity;
+    _Atomic size_t inbox_size;
+    /* Statistics */
+    _Atomic uint64_t num_steals;
+    _Alignas(64) _Atomic uint64_t steal_requests; /* failed steal attempts */
+} chase_lev_pool_t;
+
+static inline chase_lev_pool_t *chase_lev_get(ABT_pool pool)
+{
+    void *data;
+    ABT_pool_get_data(pool, &data);
+    return (chase_lev_pool_t *)data;
+}
+
+static inline int chase_lev_is_owner(const chase_lev_pool_t *p)
+{
+    int rank;
+    return ABT_xstream_self_rank(&rank) == ABT_SUCCESS && rank == p->owner_rank;
+}
+
+/* Owner only */
+static inline int chase_lev_push_bottom(chase_lev_pool_t *p, ABT_unit unit)
+{
+    int64_t b = atomic_load_explicit(&p->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&p->top, memory_order_acquire);
+    if (b - t > p->mask)
+        return -1; /* full */
+    atomic_store_explicit(&p->buffer[b & p->mask], unit, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&p->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+/* Owner only */
+static inline ABT_unit chase_lev_take_bottom(chase_lev_pool_t *p)
+{
+    int64_t b = atomic_load_explicit(&p->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&p->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = atomic_load_explicit(&p->top, memory_order_relaxed);
+    ABT_unit unit = ABT_UNIT_NULL;
+
+    if (t <= b) {
+        unit = atomic_load_explicit(&p->buffer[b & p->mask],
+                                    memory_order_relaxed);
+        if (t == b) {
+            /* Last element: race against thieves for it */
+            if (!atomic_compare_exchange_strong_explicit(
+                    &p->top, &t, t + 1, memory_order_seq_cst,
+                    memory_order_relaxed))
+                unit = ABT_UNIT_NULL;
+            atomic_store_explicit(&p->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&p->bottom, b + 1, memory_order_relaxed);
+    }
+    return unit;
+}
+
+/* Any execution stream; returns ABT_UNIT_NULL if empty or if the race was lost */
+static inline ABT_unit chase_lev_steal_top(chase_lev_pool_t *p)
+{
+    int64_t t = atomic_load_explicit(&p->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = atomic_load_explicit(&p->bottom, memory_order_acquire);
+
+    if (t < b) {
+        ABT_unit unit = atomic_load_explicit(&p->buffer[t & p->mask],
+                                             memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(
+                &p->top, &t, t + 1, memory_order_seq_cst,
+                memory_order_relaxed))
+            return unit;
+    }
+    return ABT_UNIT_NULL;
+}
+
+static inline void chase_lev_inbox_push(chase_lev_pool_t *p, ABT_unit unit)
+{
+    while (atomic_flag_test_and_set_explicit(&p->inbox_lock,
+                                             memory_order_acquire))
+        ;
+    size_t size = atomic_load_explicit(&p->inbox_size, memory_order_relaxed);
+    if (size == p->inbox_capacity) {
+        size_t capacity = p->inbox_capacity ? p->inbox_capacity * 2 : 64;
+        ABT_unit *inbox = malloc(sizeof(ABT_unit) * capacity);
+        for (size_t i = 0; i < size; i++)
+            inbox[i] = p->inbox[(p->inbox_head + i) % p->inbox_capacity];
+        free(p->inbox);
+        p->inbox = inbox;
+        p->inbox_head = 0;
+        p->inbox_capacity = capacity;
+    }
+    p->inbox[(p->inbox_head + size) % p->inbox_capacity] = unit;
+    atomic_store_explicit(&p->inbox_size, size + 1, memory_order_relaxed);
+    atomic_flag_clear_explicit(&p->inbox_lock, memory_order_release);
+}
+
+static inline ABT_unit chase_lev_inbox_pop(chase_lev_pool_t *p)
+{
+    ABT_unit unit = ABT_UNIT_NULL;
+    if (atomic_load_explicit(&p->inbox_size, memory_order_relaxed) == 0)
+        return unit;
+    while (atomic_flag_test_and_set_explicit(&p->inbox_lock,
+                                             memory_order_acquire))
+        ;
+    size_t size = atomic_load_explicit(&p->inbox_size, memory_order_relaxed);
+    if (size > 0) {
+        unit = p->inbox[p->inbox_head];
+        p->inbox_head = (p->inbox_head + 1) % p->inbox_capacity;
+        atomic_store_explicit(&p->inbox_size, size - 1, memory_order_relaxed);
+    }
+    atomic_flag_clear_explicit(&p->inbox_lock, memory_order_release);
+    return unit;
+}
+
+/* ABT_pool_user_def callbacks */
+
+/* A ULT handle is never ABT_UNIT_NULL, so it can be used as the unit itself */
+static inline ABT_unit chase_lev_create_unit(ABT_pool pool, ABT_thread thread)
+{
+    return (ABT_unit)thread;
+}
+
+static inline void chase_lev_free_unit(ABT_pool pool, ABT_unit unit)
+{
+}
+
+static inline size_t chase_lev_get_size(ABT_pool pool)
+{
+    chase_lev_pool_t *p = chase_lev_get(pool);
+    int64_t b = atomic_load_explicit(&p->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&p->top, memory_order_relaxed);
+    size_t size = atomic_load_explicit(&p->inbox_size, memory_order_relaxed);
+    return size + (b > t ? (size_t)(b - t) : 0);
+}
+
+static inline ABT_bool chase_lev_is_empty(ABT_pool pool)
+{
+    return chase_lev_get_size(pool) == 0 ? ABT_TRUE : ABT_FALSE;
+}
+
+static inline void chase_lev_push(ABT_pool pool, ABT_unit unit,
+                                  ABT_pool_context context)
+{
+    chase_lev_pool_t *p = chase_lev_get(pool);
+    if (!chase_lev_is_owner(p) || chase_lev_push_bottom(p, unit) != 0)
+        chase_lev_inbox_push(p, unit);
+}
+
+static inline ABT_thread chase_lev_pop(ABT_pool pool, ABT_pool_context context)
+{
+    chase_lev_pool_t *p = chase_lev_get(pool);
+    int owner = chase_lev_is_owner(p);
+    ABT_unit unit;
+
+    if (owner) {
+        unit = chase_lev_take_bottom(p);
+    } else {
+        unit = chase_lev_steal_top(p);
+        if (unit != ABT_UNIT_NULL)
+            atomic_fetch_add_explicit(&p->num_steals, 1, memory_order_relaxed);
+    }
+    if (unit == ABT_UNIT_NULL)
+        unit = chase_lev_inbox_pop(p);
+    if (unit == ABT_UNIT_NULL && !owner)
+        atomic_fetch_add_explicit(&p->steal_requests, 1, memory_order_relaxed);
+    return unit == ABT_UNIT_NULL ? ABT_THREAD_NULL : (ABT_thread)unit;
+}
+
+static inline int chase_lev_init(ABT_pool pool, ABT_pool_config config)
+{
+    chase_lev_pool_t *p = aligned_alloc(64, sizeof(chase_lev_pool_t));
+    if (!p)
+        return ABT_ERR_MEM;
+
+    atomic_init(&p->top, 0);
+    atomic_init(&p->bottom, 0);
+    p->buffer = calloc(CHASE_LEV_CAPACITY, sizeof(*p->buffer));
+    if (!p->buffer) {
+        free(p);
+        return ABT_ERR_MEM;
+    }
+    p->mask = CHASE_LEV_CAPACITY - 1;
+    p->owner_rank = -1;
+    if (config != ABT_POOL_CONFIG_NULL) {
+        ABT_pool_config_type type;
+        ABT_pool_config_get(config, CHASE_LEV_OWNER_KEY, &type, &p->owner_rank);
+    }
+    atomic_flag_clear(&p->inbox_lock);
+    p->inbox = NULL;
+    p->inbox_head = 0;
+    p->inbox_capacity = 0;
+    atomic_init(&p->inbox_size, 0);
+    atomic_init(&p->num_steals, 0);
+    atomic_init(&p->steal_requests, 0);
+
+    ABT_pool_set_data(pool, p);
+    return ABT_SUCCESS;
+}
+
+static inline void chase_lev_free(ABT_pool pool)
+{
+    chase_lev_pool_t *p = chase_lev_get(pool);
+    free(p->inbox);
+    free((void *)p->buffer);
+    free(p);
+}
+
+/*
+ * Create a Chase-Lev pool owned by the execution stream of rank owner_rank.
+ * The pool is freed automatically together with the scheduler using it.
+ */
+static inline int chase_lev_pool_create(int owner_rank, ABT_pool *newpool)
+{
+    ABT_pool_user_def def;
+    ABT_pool_config config;
+    const int automatic = 1;
+    int ret;
+
+    ABT_pool_user_def_create(chase_lev_create_unit, chase_lev_free_unit,
+                             chase_lev_is_empty, chase_lev_pop, chase_lev_push,
+                             &def);
+    ABT_pool_user_def_set_init(def, chase_lev_init);
+    ABT_pool_user_def_set_free(def, chase_lev_free);
+    ABT_pool_user_def_set_get_size(def, chase_lev_get_size);
+
+    ABT_pool_config_create(&config);
+    ABT_pool_config_set(config, ABT_pool_config_automatic.key,
+                        ABT_pool_config_automatic.type, &automatic);
+    ABT_pool_config_set(config, CHASE_LEV_OWNER_KEY, ABT_POOL_CONFIG_INT,
+                        &owner_rank);
+
+    ret = ABT_pool_create(def, config, newpool);
+
+    ABT_pool_config_free(&config);
+    ABT_pool_user_def_free(&def);
+    return ret;
+}
+
+/* Number of work units other execution streams have stolen from this pool */
+static inline uint64_t chase_lev_pool_get_steals(ABT_pool pool)
+{
+    return atomic_load_explicit(&chase_lev_get(pool)->num_steals,
+                                memory_order_relaxed);
+}
+
+/*
+ * Number of times another execution stream found this pool empty since the
+ * last call. A non-zero value means a thief is looking for work right now,
+ * which lazy task creation uses to decide when spawning is worth it.
+ */
+static inline uint64_t chase_lev_pool_take_steal_requests(ABT_pool pool)
+{
+    chase_lev_pool_t *p = chase_lev_get(pool);
+    if (atomic_load_explicit(&p->steal_requests, memory_order_relaxed) == 0)
+        return 0;
+    return atomic_exchange_explicit(&p->steal_requests, 0,
+                                    memory_order_relaxed);
+}
+
+#endif /* CHASE_LEV_POOL_H */
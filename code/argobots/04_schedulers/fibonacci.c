@@ -1,82 +1,255 @@
 /*
  * Recursive Fibonacci with work-stealing schedulers
  * Demonstrates divide-and-conquer parallelism with dynamic load balancing
+ *
+ * Usage: 04_abt_fibonacci [-x xstreams] [-n fib_n] [-p fifo|chaselev]
+ *                         [-t cutoff | -a] [-l] [-c]
+ *   -p selects the pool: built-in MPMC FIFO or Chase-Lev deque (chase_lev_pool.h)
+ *   -t computes fib(n) serially for n <= cutoff instead of spawning ULTs
+ *   -a picks the cutoff from the measured cost of spawning a ULT
+ *   -l lazy task creation: only spawn a ULT when another xstream wants work
+ *   -c prints a single CSV record instead of the human-readable report
+ *      (this is the format expected by 10_performance_debug/scaling_sweep.sh)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
 #include <abt.h>
+#include "chase_lev_pool.h"
 
 #define NUM_XSTREAMS 4
 #define FIB_N 20
+#define CUTOFF 2
+/* Adaptive mode: leaves must cost at least this many ULT spawns */
+#define GRANULARITY_FACTOR 10
+#define CALIBRATION_ROUNDS 1000
+/* Lazy mode: spawn only while the own pool holds fewer queued ULTs */
+#define LAZY_MAX_QUEUED 1
 
 ABT_pool *pools;
 int num_pools;
+int cutoff = CUTOFF;
+int lazy = 0;
+int use_chase_lev = 0;
+
+/* ULTs created and not yet freed (each one holds a stack) */
+_Atomic long live_ults = 0;
+_Atomic long peak_live_ults = 0;
 
 typedef struct {
     int n;
     int result;
+    int creator_rank; /* xstream that created this ULT */
 } fib_arg_t;
 
+/* Per-xstream counters, padded to avoid false sharing */
+typedef struct {
+    _Alignas(64) long tasks;  /* ULTs created by this xstream */
+    long steals;              /* ULTs created elsewhere that ran here */
+} xstream_stats_t;
+
+xstream_stats_t *stats;
+
+/* Serial version, used below the cutoff and as the speedup baseline */
+int fibonacci(int n)
+{
+    if (n <= 2) return 1;
+    return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+/*
+ * Lazy task creation: a spawned child is only useful if another xstream
+ * can steal it. If work is already queued in our pool, or (with the
+ * Chase-Lev pool) no thief has found an empty pool lately, the child is
+ * run inline instead and no stack is allocated for it.
+ */
+int work_wanted(ABT_pool pool)
+{
+    size_t queued;
+    ABT_pool_get_size(pool, &queued);
+    if (queued >= LAZY_MAX_QUEUED)
+        return 0;
+    if (use_chase_lev)
+        return chase_lev_pool_take_steal_requests(pool) > 0;
+    return 1;
+}
+
+void track_live_ults(long delta)
+{
+    long live = atomic_fetch_add_explicit(&live_ults, delta,
+                                          memory_order_relaxed) + delta;
+    long peak = atomic_load_explicit(&peak_live_ults, memory_order_relaxed);
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&peak_live_ults, &peak, live,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
 void fibonacci_ult(void *arg)
 {
     fib_arg_t *fib = (fib_arg_t *)arg;
     int n = fib->n;
 
-    if (n <= 2) {
-        fib->result = 1;
+    int rank;
+    ABT_xstream_self_rank(&rank);
+    if (rank != fib->creator_rank)
+        stats[rank].steals++;
+
+    /* Below the cutoff, spawning costs more than it can save */
+    if (n <= cutoff) {
+        fib->result = fibonacci(n);
         return;
     }
 
     /* Create child tasks */
-    fib_arg_t child1 = {n - 1, 0};
-    fib_arg_t child2 = {n - 2, 0};
+    fib_arg_t child1 = {n - 1, 0, rank};
+    fib_arg_t child2 = {n - 2, 0, rank};
 
-    int rank;
-    ABT_xstream_self_rank(&rank);
     ABT_pool target_pool = pools[rank % num_pools];
 
+    if (lazy && !work_wanted(target_pool)) {
+        /* Nobody is hungry: run both children inline */
+        fibonacci_ult(&child1);
+        fibonacci_ult(&child2);
+        fib->result = child1.result + child2.result;
+        return;
+    }
+
     ABT_thread thread1;
+    track_live_ults(1);
     ABT_thread_create(target_pool, fibonacci_ult, &child1,
                       ABT_THREAD_ATTR_NULL, &thread1);
+    stats[rank].tasks++;
 
     /* Calculate child2 directly (no need to create another ULT) */
     fibonacci_ult(&child2);
 
     /* Wait for child1 */
     ABT_thread_free(&thread1);
+    track_live_ults(-1);
 
     fib->result = child1.result + child2.result;
 }
 
+void empty_ult(void *arg)
+{
+}
+
+/*
+ * Adaptive cutoff: measure what creating and joining a ULT costs on this
+ * xstream, then return the smallest n whose serial fib(n) costs at least
+ * GRANULARITY_FACTOR times as much, so that spawn overhead stays below ~10%.
+ */
+int calibrate_cutoff(ABT_pool pool, int max_n)
+{
+    ABT_thread thread;
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < CALIBRATION_ROUNDS; i++) {
+        ABT_thread_create(pool, empty_ult, NULL, ABT_THREAD_ATTR_NULL, &thread);
+        ABT_thread_free(&thread);
+    }
+    double spawn_cost = (ABT_get_wtime() - start_time) / CALIBRATION_ROUNDS;
+
+    int n;
+    for (n = 3; n < max_n; n++) {
+        volatile int sink;
+        int rounds = 0;
+        start_time = ABT_get_wtime();
+        do {
+            sink = fibonacci(n);
+            rounds++;
+        } while (ABT_get_wtime() - start_time < 1e-3);
+        (void)sink;
+        double leaf_cost = (ABT_get_wtime() - start_time) / rounds;
+        if (leaf_cost >= GRANULARITY_FACTOR * spawn_cost)
+            break;
+    }
+    return n;
+}
+
 int main(int argc, char **argv)
 {
-    ABT_xstream xstreams[NUM_XSTREAMS];
-    ABT_pool local_pools[NUM_XSTREAMS];
-    ABT_sched scheds[NUM_XSTREAMS];
-    fib_arg_t fib_task = {FIB_N, 0};
+    int num_xstreams = NUM_XSTREAMS;
+    int fib_n = FIB_N;
+    const char *pool_kind = "fifo";
+    int adaptive = 0;
+    int csv = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:p:t:alc")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': fib_n = atoi(optarg); break;
+            case 'p': pool_kind = optarg; break;
+            case 't': cutoff = atoi(optarg); break;
+            case 'a': adaptive = 1; break;
+            case 'l': lazy = 1; break;
+            case 'c': csv = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n fib_n] "
+                        "[-p fifo|chaselev] [-t cutoff | -a] [-l] [-c]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || fib_n < 1 || fib_n > 46 || cutoff < 2) {
+        fprintf(stderr, "Error: need xstreams >= 1, 1 <= fib_n <= 46 "
+                "and cutoff >= 2\n");
+        return 1;
+    }
+    if (strcmp(pool_kind, "fifo") != 0 && strcmp(pool_kind, "chaselev") != 0) {
+        fprintf(stderr, "Error: unknown pool kind %s\n", pool_kind);
+        return 1;
+    }
+    use_chase_lev = strcmp(pool_kind, "chaselev") == 0;
+
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *local_pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_sched *scheds = malloc(sizeof(ABT_sched) * num_xstreams);
+    fib_arg_t fib_task = {fib_n, 0, 0};
+    stats = aligned_alloc(64, sizeof(xstream_stats_t) * num_xstreams);
+    for (int i = 0; i < num_xstreams; i++) {
+        stats[i].tasks = 0;
+        stats[i].steals = 0;
+    }
+
+    /* Serial baseline */
+    double start_time = ABT_get_wtime();
+    int serial_result = fibonacci(fib_n);
+    double serial_time = ABT_get_wtime() - start_time;
 
     ABT_init(argc, argv);
 
-    printf("=== Fibonacci with Work-Stealing ===\n");
-    printf("Computing fib(%d) with %d execution streams\n\n", FIB_N, NUM_XSTREAMS);
+    if (!csv) {
+        printf("=== Fibonacci with Work-Stealing ===\n");
+        printf("Computing fib(%d) with %d execution streams (%s pools)\n\n",
+               fib_n, num_xstreams, pool_kind);
+    }
 
-    num_pools = NUM_XSTREAMS;
+    num_pools = num_xstreams;
     pools = local_pools;
 
-    /* Create pools */
-    for (int i = 0; i < NUM_XSTREAMS; i++) {
-        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC,
-                              ABT_TRUE, &pools[i]);
+    /* Create pools: pool i is owned by the execution stream of rank i */
+    for (int i = 0; i < num_xstreams; i++) {
+        if (use_chase_lev) {
+            chase_lev_pool_create(i, &pools[i]);
+        } else {
+            ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC,
+                                  ABT_TRUE, &pools[i]);
+        }
     }
 
     /* Create work-stealing schedulers */
-    for (int i = 0; i < NUM_XSTREAMS; i++) {
-        ABT_pool *sched_pools = malloc(sizeof(ABT_pool) * NUM_XSTREAMS);
-        for (int j = 0; j < NUM_XSTREAMS; j++) {
-            sched_pools[j] = pools[(i + j) % NUM_XSTREAMS];
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool *sched_pools = malloc(sizeof(ABT_pool) * num_xstreams);
+        for (int j = 0; j < num_xstreams; j++) {
+            sched_pools[j] = pools[(i + j) % num_xstreams];
         }
-        ABT_sched_create_basic(ABT_SCHED_RANDWS, NUM_XSTREAMS,
+        ABT_sched_create_basic(ABT_SCHED_RANDWS, num_xstreams,
                                sched_pools, ABT_SCHED_CONFIG_NULL, &scheds[i]);
         free(sched_pools);
     }
@@ -85,26 +258,66 @@ int main(int argc, char **argv)
     ABT_xstream_self(&xstreams[0]);
     ABT_xstream_set_main_sched(xstreams[0], scheds[0]);
 
-    for (int i = 1; i < NUM_XSTREAMS; i++) {
+    for (int i = 1; i < num_xstreams; i++) {
         ABT_xstream_create(scheds[i], &xstreams[i]);
     }
 
+    if (adaptive)
+        cutoff = calibrate_cutoff(pools[0], fib_n);
+
     /* Compute fibonacci */
+    start_time = ABT_get_wtime();
     ABT_thread main_thread;
     ABT_thread_create(pools[0], fibonacci_ult, &fib_task,
                       ABT_THREAD_ATTR_NULL, &main_thread);
     ABT_thread_free(&main_thread);
+    double elapsed = ABT_get_wtime() - start_time;
 
-    printf("fib(%d) = %d\n", FIB_N, fib_task.result);
+    long tasks = 1, steals = 0; /* count the root ULT */
+    for (int i = 0; i < num_xstreams; i++) {
+        tasks += stats[i].tasks;
+        steals += stats[i].steals;
+    }
+    if (csv) {
+        /* benchmark,xstreams,units,size,seconds,throughput */
+        printf("fibonacci-%s,%d,%ld,%d,%.6f,%.2f\n", pool_kind, num_xstreams,
+               tasks, fib_n, elapsed, tasks / elapsed);
+    } else {
+        printf("fib(%d) = %d (serial: %d)\n", fib_n, fib_task.result,
+               serial_result);
+        printf("Cutoff: %d%s\n", cutoff, adaptive ? " (adaptive)" : "");
+        printf("ULTs created: %ld, stolen: %ld%s\n", tasks, steals,
+               lazy ? " (lazy task creation)" : "");
+        if (use_chase_lev) {
+            /* Units taken from the top of another xstream's deque */
+            uint64_t pool_steals = 0;
+            for (int i = 0; i < num_xstreams; i++)
+                pool_steals += chase_lev_pool_get_steals(pools[i]);
+            printf("Chase-Lev pool steals: %llu\n",
+                   (unsigned long long)pool_steals);
+        }
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        printf("Peak live ULTs: %ld, peak RSS: %.1f MB\n",
+               atomic_load(&peak_live_ults) + 1, usage.ru_maxrss / 1024.0);
+        printf("Parallel: %.4f s, serial: %.4f s, speedup: %.2fx\n",
+               elapsed, serial_time, serial_time / elapsed);
+    }
 
     /* Cleanup */
-    for (int i = 1; i < NUM_XSTREAMS; i++) {
+    for (int i = 1; i < num_xstreams; i++) {
         ABT_xstream_join(xstreams[i]);
         ABT_xstream_free(&xstreams[i]);
     }
 
-    printf("\nWork-stealing enabled dynamic load balancing across execution streams\n");
+    if (!csv)
+        printf("\nWork-stealing enabled dynamic load balancing across execution streams\n");
 
     ABT_finalize();
+
+    free(stats);
+    free(scheds);
+    free(local_pools);
+    free(xstreams);
     return 0;
 }
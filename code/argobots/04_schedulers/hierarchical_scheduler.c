@@ -0,0 +1,528 @@
+/*
+ * Topology-aware hierarchical work-stealing scheduler
+ * Private pool per xstream, shared pool per socket (or L3 domain), remote
+ * domains stolen from last; benchmarked against the flat RANDWS ring
+ *
+ * The flat ring of work_stealing.c lets any xstream steal from any other with
+ * equal preference. On a multi-socket node, a steal from another socket moves
+ * the ULT away from the data it works on, and every poll of a remote pool
+ * bounces that pool's cache lines across the interconnect. This scheduler
+ * looks for work in order of distance:
+ *   1. its own private pool
+ *   2. the shared pool of its domain
+ *   3. the private pools of the other xstreams of its domain (local steal)
+ *   4. the pools of the other domains (remote steal)
+ * The domain of an xstream is read from /sys for the CPU it is bound to:
+ * the id of its L3 cache, or its physical package id (socket).
+ *
+ * Usage: 04_abt_hierarchical_scheduler [-x xstreams] [-n tasks]
+ *                                      [-w working_set_kb] [-t l3|socket]
+ *                                      [-d xstreams_per_domain]
+ *   -d ignores the topology and groups consecutive xstreams into domains,
+ *      which emulates a multi-socket node on a single-socket machine
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 4
+#define NUM_TASKS 1000
+#define CHILDREN 8             /* children forked per task, 4x for heavy tasks */
+#define WORKING_SET_KB 256     /* per-domain data read by every child */
+#define EVENT_FREQ 64          /* check events every EVENT_FREQ iterations */
+#define MAX_CPUS 1024
+
+typedef struct {
+    _Alignas(64) long local_steals; /* from a sibling's private pool */
+    long remote_steals;             /* from the pools of another domain */
+    long remote_runs;               /* children that read another domain's data */
+} hier_stats_t;
+
+typedef struct {
+    int event_freq;
+    int num_local;     /* sibling pools, after the own and the shared pool */
+    int num_pools;
+    ABT_pool *pools;
+    unsigned int seed;
+} sched_data_t;
+
+hier_stats_t *stats;   /* indexed by xstream rank */
+int *xstream_domain;   /* domain of each xstream rank */
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_num_local = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 2, &data->event_freq, &data->num_local);
+    ABT_sched_get_num_pools(sched, &data->num_pools);
+    data->pools = (ABT_pool *)malloc(sizeof(ABT_pool) * data->num_pools);
+    ABT_sched_get_pools(sched, data->num_pools, 0, data->pools);
+    data->seed = (unsigned int)(size_t)sched;
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+/* xorshift32: cheap per-scheduler random numbers for victim selection */
+static unsigned int next_random(unsigned int *state)
+{
+    unsigned int x = *state ? *state : 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* Try pools[first .. first + count - 1], starting at a random one */
+static ABT_thread pop_any(ABT_pool *pools, int first, int count,
+                          unsigned int *seed)
+{
+    if (count <= 0)
+        return ABT_THREAD_NULL;
+
+    int start = next_random(seed) % count;
+    for (int i = 0; i < count; i++) {
+        ABT_thread thread;
+        ABT_pool_pop_thread(pools[first + (start + i) % count], &thread);
+        if (thread != ABT_THREAD_NULL)
+            return thread;
+    }
+    return ABT_THREAD_NULL;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int rank, work_count = 0;
+
+    ABT_sched_get_data(sched, (void **)&data);
+    ABT_xstream_self_rank(&rank);
+    hier_stats_t *st = &stats[rank];
+    int first_remote = 2 + data->num_local;
+
+    while (1) {
+        ABT_thread thread;
+
+        /* 1. Own private pool, 2. shared pool of the domain */
+        ABT_pool_pop_thread(data->pools[0], &thread);
+        if (thread == ABT_THREAD_NULL)
+            ABT_pool_pop_thread(data->pools[1], &thread);
+
+        /* 3. Siblings in the same domain */
+        if (thread == ABT_THREAD_NULL) {
+            thread = pop_any(data->pools, 2, data->num_local, &data->seed);
+            if (thread != ABT_THREAD_NULL)
+                st->local_steals++;
+        }
+
+        /* 4. Other domains, only when the whole domain is out of work */
+        if (thread == ABT_THREAD_NULL) {
+            thread = pop_any(data->pools, first_remote,
+                             data->num_pools - first_remote, &data->seed);
+            if (thread != ABT_THREAD_NULL)
+                st->remote_steals++;
+        }
+
+        if (thread != ABT_THREAD_NULL)
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data->pools);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/*
+ * pools[0] is the own private pool, pools[1] the shared pool of the domain,
+ * the next num_local pools belong to the same domain and the rest are remote
+ */
+int hier_sched_create(int num_pools, ABT_pool *pools, int num_local,
+                      ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_num_local, num_local,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, num_pools, pools, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Topology ---- */
+
+typedef struct {
+    int cpu;
+    int domain; /* L3 id or package id, as reported by /sys */
+} cpu_domain_t;
+
+/* Read an integer from a /sys file, -1 if unavailable */
+static int read_sysfs_int(const char *path)
+{
+    int value = -1;
+    FILE *f = fopen(path, "r");
+    if (f) {
+        if (fscanf(f, "%d", &value) != 1)
+            value = -1;
+        fclose(f);
+    }
+    return value;
+}
+
+static int cpu_domain_id(int cpu, int use_l3)
+{
+    char path[128];
+    int id = -1;
+
+    if (use_l3) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index3/level", cpu);
+        if (read_sysfs_int(path) == 3) {
+            snprintf(path, sizeof(path),
+                     "/sys/devices/system/cpu/cpu%d/cache/index3/id", cpu);
+            id = read_sysfs_int(path);
+        }
+    }
+    if (id < 0) {
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+                 cpu);
+        id = read_sysfs_int(path);
+    }
+    return id < 0 ? 0 : id;
+}
+
+static int cmp_cpu_domain(const void *a, const void *b)
+{
+    const cpu_domain_t *x = a, *y = b;
+    if (x->domain != y->domain) return x->domain - y->domain;
+    return x->cpu - y->cpu;
+}
+
+/*
+ * Bind xstream i to cpus[i], filling one domain before the next, and number
+ * the domains of the xstreams from 0. With per_domain > 0 the topology is
+ * ignored and xstream i is put in domain i / per_domain.
+ * Returns the number of domains; cpus[i] is -1 if CPUs are unknown.
+ */
+int build_domains(int num_xstreams, int use_l3, int per_domain,
+                  int *cpus, int *domains)
+{
+    cpu_domain_t *info = malloc(sizeof(cpu_domain_t) * MAX_CPUS);
+    int *ids = malloc(sizeof(int) * num_xstreams);
+    int count = 0, num_domains = 0;
+    cpu_set_t allowed;
+
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && count < MAX_CPUS; cpu++) {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+            info[count].cpu = cpu;
+            info[count].domain = cpu_domain_id(cpu, use_l3);
+            count++;
+        }
+        qsort(info, count, sizeof(cpu_domain_t), cmp_cpu_domain);
+    }
+
+    for (int i = 0; i < num_xstreams; i++) {
+        cpus[i] = count > 0 ? info[i % count].cpu : -1;
+        int raw = per_domain > 0 ? i / per_domain
+                                 : (count > 0 ? info[i % count].domain : 0);
+        /* Renumber raw ids densely, in order of first appearance */
+        int d;
+        for (d = 0; d < num_domains && ids[d] != raw; d++)
+            ;
+        if (d == num_domains)
+            ids[num_domains++] = raw;
+        domains[i] = d;
+    }
+
+    free(ids);
+    free(info);
+    return num_domains;
+}
+
+/* ---- Benchmark ---- */
+
+int num_domains;
+char **domain_data;    /* working set of each domain, first touched there */
+size_t data_size;
+ABT_pool *private_pools;
+
+/* Reads the working set of its domain, like a kernel operating on local data */
+void child_func(void *arg)
+{
+    int domain = (int)(size_t)arg;
+    int rank;
+    ABT_xstream_self_rank(&rank);
+    if (xstream_domain[rank] != domain)
+        stats[rank].remote_runs++;
+
+    volatile long sum = 0;
+    for (size_t i = 0; i < data_size; i += 64)
+        sum += domain_data[domain][i];
+}
+
+/* A task of domain id % num_domains forks its children into the local pool */
+void task_func(void *arg)
+{
+    int id = (int)(size_t)arg;
+    int num_children = (id % 4 == 0) ? 4 * CHILDREN : CHILDREN;
+    ABT_thread children[4 * CHILDREN];
+    int rank;
+    ABT_xstream_self_rank(&rank);
+
+    for (int i = 0; i < num_children; i++) {
+        ABT_thread_create(private_pools[rank], child_func,
+                          (void *)(size_t)(id % num_domains),
+                          ABT_THREAD_ATTR_NULL, &children[i]);
+    }
+    for (int i = 0; i < num_children; i++) {
+        ABT_thread_free(&children[i]);
+    }
+}
+
+void first_touch(void *arg)
+{
+    memset(arg, 1, data_size);
+}
+
+double run_benchmark(int hierarchical, int num_xstreams, int num_tasks,
+                     const int *cpus)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_sched *scheds = malloc(sizeof(ABT_sched) * num_xstreams);
+    ABT_pool *shared_pools = malloc(sizeof(ABT_pool) * num_domains);
+    ABT_pool *sched_pools = malloc(sizeof(ABT_pool) * (num_xstreams + num_domains));
+    int max_threads = num_tasks > num_domains ? num_tasks : num_domains;
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * max_threads);
+    /* Xstream ranks grouped by domain */
+    int *members = malloc(sizeof(int) * num_xstreams);
+    int *domain_start = calloc(num_domains + 1, sizeof(int));
+
+    for (int i = 0; i < num_xstreams; i++)
+        domain_start[xstream_domain[i] + 1]++;
+    for (int d = 0; d < num_domains; d++)
+        domain_start[d + 1] += domain_start[d];
+    for (int d = 0, k = 0; d < num_domains; d++)
+        for (int i = 0; i < num_xstreams; i++)
+            if (xstream_domain[i] == d)
+                members[k++] = i;
+
+    ABT_init(0, NULL);
+
+    private_pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC,
+                              ABT_TRUE, &private_pools[i]);
+    }
+
+    for (int i = 0; i < num_xstreams && !hierarchical; i++) {
+        for (int j = 0; j < num_xstreams; j++) {
+            sched_pools[j] = private_pools[(i + j) % num_xstreams];
+        }
+        ABT_sched_create_basic(ABT_SCHED_RANDWS, num_xstreams, sched_pools,
+                               ABT_SCHED_CONFIG_NULL, &scheds[i]);
+    }
+
+    if (hierarchical) {
+        for (int d = 0; d < num_domains; d++) {
+            ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC,
+                                  ABT_TRUE, &shared_pools[d]);
+        }
+        for (int i = 0; i < num_xstreams; i++) {
+            int dom = xstream_domain[i], n = 0;
+            sched_pools[n++] = private_pools[i];
+            sched_pools[n++] = shared_pools[dom];
+            for (int k = domain_start[dom]; k < domain_start[dom + 1]; k++)
+                if (members[k] != i)
+                    sched_pools[n++] = private_pools[members[k]];
+            int num_local = n - 2;
+            for (int d = 0; d < num_domains; d++) {
+                if (d == dom)
+                    continue;
+                sched_pools[n++] = shared_pools[d];
+                for (int k = domain_start[d]; k < domain_start[d + 1]; k++)
+                    sched_pools[n++] = private_pools[members[k]];
+            }
+            hier_sched_create(n, sched_pools, num_local, &scheds[i]);
+        }
+    }
+
+    ABT_xstream_self(&xstreams[0]);
+    ABT_xstream_set_main_sched(xstreams[0], scheds[0]);
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_create(scheds[i], &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        if (cpus[i] >= 0)
+            ABT_xstream_set_cpubind(xstreams[i], cpus[i]);
+    }
+
+    /* Place each domain's data in the memory of that domain */
+    for (int d = 0; d < num_domains; d++) {
+        domain_data[d] = malloc(data_size);
+        ABT_thread_create(private_pools[members[domain_start[d]]], first_touch,
+                          domain_data[d], ABT_THREAD_ATTR_NULL, &threads[d]);
+    }
+    for (int d = 0; d < num_domains; d++) {
+        ABT_thread_free(&threads[d]);
+    }
+
+    memset(stats, 0, sizeof(hier_stats_t) * num_xstreams);
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_tasks; i++) {
+        int d = i % num_domains;
+        ABT_pool target;
+        if (hierarchical) {
+            target = shared_pools[d];
+        } else {
+            /* Round-robin over the xstreams of the domain */
+            int size = domain_start[d + 1] - domain_start[d];
+            target = private_pools[members[domain_start[d] +
+                                           (i / num_domains) % size]];
+        }
+        ABT_thread_create(target, task_func, (void *)(size_t)i,
+                          ABT_THREAD_ATTR_NULL, &threads[i]);
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    ABT_finalize();
+
+    for (int d = 0; d < num_domains; d++)
+        free(domain_data[d]);
+    free(private_pools);
+    free(domain_start);
+    free(members);
+    free(threads);
+    free(sched_pools);
+    free(shared_pools);
+    free(scheds);
+    free(xstreams);
+    return elapsed;
+}
+
+void print_row(const char *name, double elapsed, int num_xstreams,
+               int has_steal_counts)
+{
+    long local = 0, remote = 0, remote_runs = 0;
+    for (int i = 0; i < num_xstreams; i++) {
+        local += stats[i].local_steals;
+        remote += stats[i].remote_steals;
+        remote_runs += stats[i].remote_runs;
+    }
+    if (has_steal_counts)
+        printf("%-14s %10.4f %13ld %14ld %12ld\n", name, elapsed, local,
+               remote, remote_runs);
+    else
+        printf("%-14s %10.4f %13s %14s %12ld\n", name, elapsed, "-", "-",
+               remote_runs);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_tasks = NUM_TASKS;
+    int working_set_kb = WORKING_SET_KB;
+    int per_domain = 0;
+    const char *level = "l3";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:w:t:d:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_tasks = atoi(optarg); break;
+            case 'w': working_set_kb = atoi(optarg); break;
+            case 't': level = optarg; break;
+            case 'd': per_domain = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n tasks] "
+                        "[-w working_set_kb] [-t l3|socket] "
+                        "[-d xstreams_per_domain]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_tasks < 1 || working_set_kb < 1 ||
+        per_domain < 0 ||
+        (strcmp(level, "l3") != 0 && strcmp(level, "socket") != 0)) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    int *cpus = malloc(sizeof(int) * num_xstreams);
+    xstream_domain = malloc(sizeof(int) * num_xstreams);
+    num_domains = build_domains(num_xstreams, strcmp(level, "l3") == 0,
+                                per_domain, cpus, xstream_domain);
+    domain_data = malloc(sizeof(char *) * num_domains);
+    data_size = (size_t)working_set_kb * 1024;
+    stats = aligned_alloc(64, sizeof(hier_stats_t) * num_xstreams);
+
+    printf("=== Hierarchical vs Flat Work Stealing ===\n");
+    printf("%d xstreams in %d domains (%s), %d tasks, %d KB per domain\n",
+           num_xstreams, num_domains,
+           per_domain > 0 ? "emulated" : level, num_tasks, working_set_kb);
+    for (int i = 0; i < num_xstreams; i++) {
+        printf("  ES %d: CPU %d, domain %d\n", i, cpus[i], xstream_domain[i]);
+    }
+    printf("\n%-14s %10s %13s %14s %12s\n", "scheduler", "time(s)",
+           "local steals", "remote steals", "remote runs");
+
+    double flat_time = run_benchmark(0, num_xstreams, num_tasks, cpus);
+    print_row("flat RANDWS", flat_time, num_xstreams, 0);
+    double hier_time = run_benchmark(1, num_xstreams, num_tasks, cpus);
+    print_row("hierarchical", hier_time, num_xstreams, 1);
+
+    printf("\nSpeedup of hierarchical over flat: %.2fx\n", flat_time / hier_time);
+    printf("Remote runs: child ULTs that read another domain's data\n");
+
+    free(stats);
+    free(domain_data);
+    free(xstream_domain);
+    free(cpus);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Built-in MPMC FIFO pool vs Chase-Lev deque pool on the Fibonacci example
+#
+# Usage: pool_benchmark.sh [-b path/to/04_abt_fibonacci] [-n fib_n]
+#                          [-l "1 2 4 ..."] [-r repeats]
+#
+# For each xstream count, runs 04_abt_fibonacci with -p fifo and -p chaselev,
+# keeps the fastest of the repeats and prints both times and the speedup of
+# the Chase-Lev pool over the FIFO pool.
+
+binary=./04_abt_fibonacci
+fib_n=32
+list="1 2 4 $(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 8)"
+repeats=3
+
+while getopts "b:n:l:r:" opt; do
+    case $opt in
+        b) binary=$OPTARG ;;
+        n) fib_n=$OPTARG ;;
+        l) list=$OPTARG ;;
+        r) repeats=$OPTARG ;;
+        *) sed -n '5,6p' "$0" >&2; exit 1 ;;
+    esac
+done
+
+# Fastest time (5th CSV field) over the repeats, in $best; stops the
+# script if the example fails or does not print a positive time
+best_time() {
+    best=""
+    r=0
+    while [ $r -lt "$repeats" ]; do
+        out=$("$binary" -c -n "$fib_n" -x "$1" -p "$2") || {
+            echo "Error: $binary -p $2 failed at $1 xstreams" >&2
+            exit 1
+        }
+        t=$(printf '%s\n' "$out" | tail -n 1 | cut -d, -f5)
+        if ! awk -v t="$t" 'BEGIN { exit !(t + 0 > 0) }'; then
+            echo "Error: $binary -p $2 printed no time at $1 xstreams" >&2
+            exit 1
+        fi
+        if [ -z "$best" ] ||
+           awk -v t="$t" -v b="$best" 'BEGIN { exit !(t + 0 < b + 0) }'; then
+            best=$t
+        fi
+        r=$((r + 1))
+    done
+}
+
+echo "fib($fib_n), best of $repeats runs"
+printf "%8s %12s %12s %10s\n" "xstreams" "fifo(s)" "chaselev(s)" "speedup"
+for x in $list; do
+    best_time "$x" fifo
+    fifo=$best
+    best_time "$x" chaselev
+    chaselev=$best
+    awk -v x="$x" -v f="$fifo" -v c="$chaselev" \
+        'BEGIN { printf "%8d %12.4f %12.4f %9.2fx\n", x, f, c, f / c }'
+done
@@ -0,0 +1,270 @@
+/*
+ * Spin-then-park scheduler: poll for a bounded time, then sleep until a push
+ * Benchmarks wakeup latency against idle CPU consumption
+ *
+ * ABT_SCHED_BASIC and ABT_SCHED_RANDWS poll their pools forever, so an idle
+ * execution stream still uses a full core. This scheduler works on
+ * ABT_POOL_FIFO_WAIT pools: it polls for a spin budget after its pool runs
+ * empty (cheap wakeups for closely spaced work), then blocks in
+ * ABT_pool_pop_wait_thread() until a push signals the pool.
+ *
+ * Usage: 04_abt_spin_then_park [-x xstreams] [-n requests]
+ *                              [-i interval_us] [-b budget_us,...]
+ *   requests arrive every interval_us, round-robin over the xstreams;
+ *   each spin budget in the list is benchmarked, next to the predefined
+ *   BASIC (always polls) and BASIC_WAIT (never polls) schedulers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 2
+#define NUM_REQUESTS 1000
+#define INTERVAL_US 500
+#define BUDGETS "0,10,100,1000"
+#define MAX_BUDGETS 16
+#define EVENT_FREQ 64
+#define WAIT_TIMEOUT 0.01      /* seconds; bounds the delay to see a join */
+
+typedef struct {
+    int event_freq;
+    double spin_time;          /* seconds to poll before sleeping */
+    ABT_pool pool;
+} sched_data_t;
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_spin_us = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+    int spin_us;
+
+    ABT_sched_config_read(config, 2, &data->event_freq, &spin_us);
+    data->spin_time = spin_us * 1e-6;
+    ABT_sched_get_pools(sched, 1, 0, &data->pool);
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int work_count = 0;
+    double idle_since = 0.0;   /* 0 while work keeps arriving */
+
+    ABT_sched_get_data(sched, (void **)&data);
+
+    while (1) {
+        ABT_thread thread;
+        ABT_pool_pop_thread(data->pool, &thread);
+
+        if (thread == ABT_THREAD_NULL) {
+            double now = ABT_get_wtime();
+            if (idle_since == 0.0)
+                idle_since = now;
+            if (now - idle_since >= data->spin_time) {
+                /* Budget spent: sleep until a push or the timeout */
+                ABT_pool_pop_wait_thread(data->pool, &thread, WAIT_TIMEOUT);
+                /* Check for a join even if work arrived */
+                work_count = data->event_freq;
+            }
+        }
+
+        if (thread != ABT_THREAD_NULL) {
+            idle_since = 0.0;
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+        }
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/* pool must be an ABT_POOL_FIFO_WAIT pool (or implement pop_wait) */
+int spin_then_park_sched_create(ABT_pool pool, int spin_us, ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_spin_us, spin_us,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, 1, &pool, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Benchmark ---- */
+
+typedef struct {
+    double push_time;
+    double *latency;
+} request_t;
+
+void request_func(void *arg)
+{
+    request_t *req = (request_t *)arg;
+    *req->latency = ABT_get_wtime() - req->push_time;
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double cpu_seconds(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+/* spin_us < 0 selects a predefined scheduler: -1 BASIC, -2 BASIC_WAIT */
+void run_mode(const char *name, int spin_us, int num_xstreams,
+              int num_requests, int interval_us)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    request_t *requests = malloc(sizeof(request_t) * num_requests);
+    double *latencies = malloc(sizeof(double) * num_requests);
+
+    ABT_init(0, NULL);
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_sched sched;
+        ABT_pool_create_basic(spin_us == -1 ? ABT_POOL_FIFO : ABT_POOL_FIFO_WAIT,
+                              ABT_POOL_ACCESS_MPMC, ABT_TRUE, &pools[i]);
+        if (spin_us >= 0) {
+            spin_then_park_sched_create(pools[i], spin_us, &sched);
+        } else {
+            ABT_sched_create_basic(spin_us == -1 ? ABT_SCHED_BASIC
+                                                 : ABT_SCHED_BASIC_WAIT,
+                                   1, &pools[i], ABT_SCHED_CONFIG_NULL, &sched);
+        }
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+
+    /* The primary xstream sleeps between requests, so the CPU time of
+     * the process is (almost) that of the worker xstreams */
+    double cpu_start = cpu_seconds();
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_requests; i++) {
+        usleep(interval_us);
+        requests[i].latency = &latencies[i];
+        requests[i].push_time = ABT_get_wtime();
+        ABT_thread_create(pools[i % num_xstreams], request_func, &requests[i],
+                          ABT_THREAD_ATTR_NULL, NULL);
+    }
+    usleep(interval_us);
+    double elapsed = ABT_get_wtime() - start_time;
+    double cpu_time = cpu_seconds() - cpu_start;
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    ABT_finalize();
+
+    qsort(latencies, num_requests, sizeof(double), compare_double);
+    printf("%-14s %10.1f %10.1f %10.1f %14.1f\n", name,
+           latencies[num_requests / 2] * 1e6,
+           latencies[(int)(num_requests * 0.99)] * 1e6,
+           latencies[num_requests - 1] * 1e6,
+           100.0 * cpu_time / (elapsed * num_xstreams));
+
+    free(latencies);
+    free(requests);
+    free(pools);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_requests = NUM_REQUESTS;
+    int interval_us = INTERVAL_US;
+    char budget_list[256] = BUDGETS;
+    int budgets[MAX_BUDGETS], num_budgets = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:i:b:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_requests = atoi(optarg); break;
+            case 'i': interval_us = atoi(optarg); break;
+            case 'b':
+                snprintf(budget_list, sizeof(budget_list), "%s", optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n requests] "
+                        "[-i interval_us] [-b budget_us,...]\n", argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(budget_list, ","); tok && num_budgets < MAX_BUDGETS;
+         tok = strtok(NULL, ",")) {
+        budgets[num_budgets] = atoi(tok);
+        if (budgets[num_budgets] < 0) {
+            fprintf(stderr, "Error: spin budgets must be >= 0\n");
+            return 1;
+        }
+        num_budgets++;
+    }
+    if (num_xstreams < 1 || num_requests < 1 || interval_us < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Spin-then-Park Scheduler ===\n");
+    printf("%d xstreams, %d requests every %d us\n\n", num_xstreams,
+           num_requests, interval_us);
+    printf("%-14s %10s %10s %10s %14s\n", "scheduler", "p50(us)", "p99(us)",
+           "max(us)", "CPU/xstream(%)");
+
+    run_mode("BASIC", -1, num_xstreams, num_requests, interval_us);
+    run_mode("BASIC_WAIT", -2, num_xstreams, num_requests, interval_us);
+    for (int b = 0; b < num_budgets; b++) {
+        char name[32];
+        snprintf(name, sizeof(name), "spin %d us", budgets[b]);
+        run_mode(name, budgets[b], num_xstreams, num_requests, interval_us);
+    }
+
+    printf("\nLatency is measured from the push to the start of the request ULT\n");
+    return 0;
+}
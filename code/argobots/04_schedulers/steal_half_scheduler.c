@@ -0,0 +1,311 @@
+/*
+ * Custom work-stealing scheduler: random victims, steal-half, exponential backoff
+ * Benchmarked against ABT_SCHED_RANDWS on imbalanced task sets
+ *
+ * When its own pool is empty, the scheduler picks a random victim pool and
+ * migrates half of the victim's queue into its own pool with one pop_threads
+ * and one push_threads operation, instead of taking one unit per steal.
+ * Failed steals back off exponentially so idle xstreams do not hammer the
+ * victims' pool locks.
+ *
+ * Usage: 04_abt_steal_half_scheduler [-x xstreams] [-n tasks]
+ *                                    [-w light_work_iterations]
+ *                                    [-d skewed|bursty]
+ *   skewed: every task starts in the pool of ES 0
+ *   bursty: tasks arrive in bursts, each burst in the pool of one ES
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 4
+#define NUM_TASKS 10000
+#define LIGHT_WORK 10000       /* heavy tasks do 10x this */
+#define BURST_SIZE 256
+#define EVENT_FREQ 64          /* check events every EVENT_FREQ iterations */
+#define STEAL_MAX 256          /* upper bound on units moved per steal */
+#define BACKOFF_MIN 16         /* spin iterations after a failed steal */
+#define BACKOFF_MAX 16384
+
+typedef struct {
+    _Alignas(64) long steals;  /* successful steal operations */
+    long units_stolen;         /* units migrated by those steals */
+    long failed_steals;
+} steal_stats_t;
+
+typedef struct {
+    int event_freq;
+    int num_pools;
+    ABT_pool *pools;           /* pools[0] is the own pool, others are victims */
+    unsigned int seed;         /* per-scheduler random state */
+} sched_data_t;
+
+steal_stats_t *stats;          /* indexed by xstream rank */
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 1, &data->event_freq);
+    ABT_sched_get_num_pools(sched, &data->num_pools);
+    data->pools = (ABT_pool *)malloc(sizeof(ABT_pool) * data->num_pools);
+    ABT_sched_get_pools(sched, data->num_pools, 0, data->pools);
+    data->seed = (unsigned int)(size_t)sched;
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+/* xorshift32: cheap per-scheduler random numbers for victim selection */
+static unsigned int next_random(unsigned int *state)
+{
+    unsigned int x = *state ? *state : 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/*
+ * Move half of the victim's units to the own pool in one pop_threads and one
+ * push_threads, and return one of them to run right away (or ABT_THREAD_NULL).
+ */
+static ABT_thread steal_half(ABT_pool victim, ABT_pool own, steal_stats_t *st)
+{
+    ABT_thread stolen[STEAL_MAX];
+    size_t size, num = 0;
+
+    ABT_pool_get_size(victim, &size);
+    if (size == 0)
+        return ABT_THREAD_NULL;
+
+    size_t want = (size + 1) / 2;
+    if (want > STEAL_MAX)
+        want = STEAL_MAX;
+    ABT_pool_pop_threads(victim, stolen, want, &num);
+    if (num == 0)
+        return ABT_THREAD_NULL; /* someone else got there first */
+
+    if (num > 1)
+        ABT_pool_push_threads(own, &stolen[1], num - 1);
+    st->steals++;
+    st->units_stolen += num;
+    return stolen[0];
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int rank, work_count = 0;
+    int backoff = BACKOFF_MIN;
+
+    ABT_sched_get_data(sched, (void **)&data);
+    ABT_xstream_self_rank(&rank);
+    steal_stats_t *st = &stats[rank];
+
+    while (1) {
+        ABT_thread thread;
+
+        /* Own pool first */
+        ABT_pool_pop_thread(data->pools[0], &thread);
+
+        /* Then one random victim */
+        if (thread == ABT_THREAD_NULL && data->num_pools > 1) {
+            int victim = 1 + next_random(&data->seed) % (data->num_pools - 1);
+            thread = steal_half(data->pools[victim], data->pools[0], st);
+            if (thread == ABT_THREAD_NULL) {
+                st->failed_steals++;
+                for (volatile int i = 0; i < backoff; i++)
+                    ;
+                if (backoff < BACKOFF_MAX)
+                    backoff *= 2;
+            }
+        }
+
+        if (thread != ABT_THREAD_NULL) {
+            backoff = BACKOFF_MIN;
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+        }
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data->pools);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/* pools[0] is the scheduler's own pool */
+int steal_half_sched_create(int num_pools, ABT_pool *pools, ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, num_pools, pools, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Benchmark ---- */
+
+int light_work = LIGHT_WORK;
+
+void work_func(void *arg)
+{
+    int id = (int)(size_t)arg;
+    /* Same heavy/light pattern as work_stealing.c, but CPU-bound */
+    int iterations = (id % 4 == 0) ? 10 * light_work : light_work;
+    volatile double x = 0.0;
+    for (int i = 0; i < iterations; i++)
+        x += i * 0.5;
+}
+
+double run_benchmark(const char *sched_kind, const char *distribution,
+                     int num_xstreams, int num_tasks)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_sched *scheds = malloc(sizeof(ABT_sched) * num_xstreams);
+    ABT_pool *sched_pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_tasks);
+    int use_steal_half = strcmp(sched_kind, "steal-half") == 0;
+
+    ABT_init(0, NULL);
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC,
+                              ABT_TRUE, &pools[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        for (int j = 0; j < num_xstreams; j++) {
+            sched_pools[j] = pools[(i + j) % num_xstreams];
+        }
+        if (use_steal_half) {
+            steal_half_sched_create(num_xstreams, sched_pools, &scheds[i]);
+        } else {
+            ABT_sched_create_basic(ABT_SCHED_RANDWS, num_xstreams, sched_pools,
+                                   ABT_SCHED_CONFIG_NULL, &scheds[i]);
+        }
+    }
+
+    ABT_xstream_self(&xstreams[0]);
+    ABT_xstream_set_main_sched(xstreams[0], scheds[0]);
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_create(scheds[i], &xstreams[i]);
+    }
+
+    memset(stats, 0, sizeof(steal_stats_t) * num_xstreams);
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_tasks; i++) {
+        int pool_id = 0;
+        if (strcmp(distribution, "bursty") == 0)
+            pool_id = (i / BURST_SIZE) % num_xstreams;
+        ABT_thread_create(pools[pool_id], work_func, (void *)(size_t)i,
+                          ABT_THREAD_ATTR_NULL, &threads[i]);
+    }
+    for (int i = 0; i < num_tasks; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    for (int i = 1; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    ABT_finalize();
+
+    free(threads);
+    free(sched_pools);
+    free(scheds);
+    free(pools);
+    free(xstreams);
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_tasks = NUM_TASKS;
+    const char *distribution = "skewed";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:w:d:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_tasks = atoi(optarg); break;
+            case 'w': light_work = atoi(optarg); break;
+            case 'd': distribution = optarg; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n tasks] "
+                        "[-w light_work_iterations] [-d skewed|bursty]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_tasks < 1 || light_work < 0 ||
+        (strcmp(distribution, "skewed") != 0 &&
+         strcmp(distribution, "bursty") != 0)) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    stats = aligned_alloc(64, sizeof(steal_stats_t) * num_xstreams);
+
+    printf("=== Steal-Half Scheduler vs RANDWS ===\n");
+    printf("%d xstreams, %d tasks (%s), light work %d iterations\n\n",
+           num_xstreams, num_tasks, distribution, light_work);
+
+    double randws_time = run_benchmark("randws", distribution,
+                                       num_xstreams, num_tasks);
+    printf("RANDWS:     %.4f s (%.0f tasks/s)\n", randws_time,
+           num_tasks / randws_time);
+
+    double steal_half_time = run_benchmark("steal-half", distribution,
+                                           num_xstreams, num_tasks);
+    long steals = 0, units_stolen = 0, failed = 0;
+    for (int i = 0; i < num_xstreams; i++) {
+        steals += stats[i].steals;
+        units_stolen += stats[i].units_stolen;
+        failed += stats[i].failed_steals;
+    }
+    printf("Steal-half: %.4f s (%.0f tasks/s)\n", steal_half_time,
+           num_tasks / steal_half_time);
+    printf("  %ld steals moved %ld units (%.1f per steal), %ld failed attempts\n",
+           steals, units_stolen, steals ? (double)units_stolen / steals : 0.0,
+           failed);
+    printf("\nSpeedup of steal-half over RANDWS: %.2fx\n",
+           randws_time / steal_half_time);
+
+    free(stats);
+    return 0;
+}
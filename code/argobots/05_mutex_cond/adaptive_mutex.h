@@ -0,0 +1,255 @@
+/*
+ * Adaptive mutex: spin, then yield, then park, with contention statistics
+ *
+ * A contended lock goes through three phases:
+ *   spin:  retry for a budget of pause loops, calibrated at init to about
+ *          ADAPTIVE_MUTEX_SPIN_NS and then adapted to the spin count that
+ *          actually succeeded recently (as glibc's adaptive mutex does)
+ *   yield: ADAPTIVE_MUTEX_YIELDS times, ABT_thread_yield() for a ULT, so
+ *          that the holder can run if it shares the xstream, or
+ *          sched_yield() for an external thread
+ *   park:  sleep on an ABT_cond until an unlock hands the mutex over;
+ *          ABT_cond blocks a ULT without blocking its xstream and blocks
+ *          an external thread in the OS
+ * The lock word is 0 (free), 1 (locked) or 2 (locked, a waiter is parked);
+ * only an unlock that sees 2 takes the internal mutex to signal.
+ *
+ * Statistics are updated by the holder, so they need no atomics. Hold and
+ * wait times are measured only with ADAPTIVE_MUTEX_TIMING, since they read
+ * the clock on every lock and unlock.
+ */
+
+#ifndef ADAPTIVE_MUTEX_H
+#define ADAPTIVE_MUTEX_H
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define ADAPTIVE_MUTEX_TIMING 0x1
+
+#define ADAPTIVE_MUTEX_SPIN_NS 2000    /* initial spin budget */
+#define ADAPTIVE_MUTEX_MAX_SPINS 100000
+#define ADAPTIVE_MUTEX_YIELDS 4
+
+#if defined(__x86_64__) || defined(__i386__)
+#define adaptive_mutex_pause() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define adaptive_mutex_pause() __asm__ __volatile__("yield")
+#else
+#define adaptive_mutex_pause() ((void)0)
+#endif
+
+typedef struct {
+    long acquisitions;
+    long contended;            /* not acquired on the first try */
+    long by_spin;              /* contended, acquired while spinning */
+    long by_yield;
+    long by_park;
+    long handoffs;             /* unlocks that signaled a parked waiter (a
+                                * woken waiter may lose the lock to a
+                                * spinner, park again and be signaled again) */
+    double hold_time;          /* ADAPTIVE_MUTEX_TIMING only, seconds */
+    double max_hold_time;
+    double wait_time;          /* time spent in contended locks */
+    double max_wait_time;
+} adaptive_mutex_stats_t;
+
+typedef struct {
+    _Alignas(64) _Atomic int state;  /* 0 free, 1 locked, 2 contended */
+    _Atomic int spin_budget;   /* pause loops before yielding */
+    int parked;                /* waiters in ABT_cond_wait(), under park_mutex */
+    int min_spins;             /* floor, so the budget can grow again */
+    int flags;
+    double acquired_at;
+    adaptive_mutex_stats_t stats;
+    ABT_mutex_memory park_mutex_mem;
+    ABT_cond_memory park_cond_mem;
+} adaptive_mutex_t;
+
+/* Pause loops that take about ns nanoseconds on this CPU */
+static inline int adaptive_mutex_calibrate(double ns)
+{
+    const int loops = 10000;
+    double start = ABT_get_wtime();
+    for (int i = 0; i < loops; i++)
+        adaptive_mutex_pause();
+    double per_loop = (ABT_get_wtime() - start) * 1e9 / loops;
+    if (per_loop <= 0.0)
+        per_loop = 1.0;
+    int spins = (int)(ns / per_loop);
+    return spins < 1 ? 1 : (spins > ADAPTIVE_MUTEX_MAX_SPINS
+                                ? ADAPTIVE_MUTEX_MAX_SPINS : spins);
+}
+
+/* Call after ABT_init(): calibration uses ABT_get_wtime() */
+static inline void adaptive_mutex_init(adaptive_mutex_t *m, int flags)
+{
+    memset(m, 0, sizeof(adaptive_mutex_t));
+    atomic_init(&m->state, 0);
+    atomic_init(&m->spin_budget,
+                adaptive_mutex_calibrate(ADAPTIVE_MUTEX_SPIN_NS));
+    m->min_spins = atomic_load(&m->spin_budget) / 16 + 1;
+    m->flags = flags;
+    /* Equivalent to ABT_MUTEX_INITIALIZER / ABT_COND_INITIALIZER */
+    memset(&m->park_mutex_mem, 0, sizeof(m->park_mutex_mem));
+    memset(&m->park_cond_mem, 0, sizeof(m->park_cond_mem));
+}
+
+static inline int adaptive_mutex_trylock(adaptive_mutex_t *m)
+{
+    int expected = 0;
+    return atomic_compare_exchange_strong_explicit(&m->state, &expected, 1,
+                                                   memory_order_acquire,
+                                                   memory_order_relaxed);
+}
+
+/* 1 if the caller is a ULT, which may yield to other ULTs */
+static inline int adaptive_mutex_caller_is_ult(void)
+{
+    ABT_unit_type type;
+    return ABT_self_get_type(&type) == ABT_SUCCESS &&
+           type == ABT_UNIT_TYPE_THREAD;
+}
+
+static inline void adaptive_mutex_park(adaptive_mutex_t *m)
+{
+    ABT_mutex park_mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&m->park_mutex_mem);
+    ABT_cond park_cond = ABT_COND_MEMORY_GET_HANDLE(&m->park_cond_mem);
+
+    ABT_mutex_lock(park_mutex);
+    /* Marking the lock contended makes the holder signal on unlock; it
+     * can only signal once we wait, since it needs park_mutex for that */
+    while (atomic_exchange_explicit(&m->state, 2, memory_order_acquire) != 0) {
+        m->parked++;
+        ABT_cond_wait(park_cond, park_mutex);
+        m->parked--;
+    }
+    /* We own the lock; if nobody else is parked, the next parker has to
+     * take park_mutex and set 2 again, so our unlock can be a fast one */
+    if (m->parked == 0)
+        atomic_store_explicit(&m->state, 1, memory_order_relaxed);
+    ABT_mutex_unlock(park_mutex);
+}
+
+static inline void adaptive_mutex_lock(adaptive_mutex_t *m)
+{
+    if (adaptive_mutex_trylock(m)) {
+        m->stats.acquisitions++;
+        if (m->flags & ADAPTIVE_MUTEX_TIMING)
+            m->acquired_at = ABT_get_wtime();
+        return;
+    }
+
+    double start = (m->flags & ADAPTIVE_MUTEX_TIMING) ? ABT_get_wtime() : 0.0;
+    int budget = atomic_load_explicit(&m->spin_budget, memory_order_relaxed);
+    long *phase = NULL;
+
+    /* Spin: read-only until the lock looks free */
+    for (int spins = 0; spins < budget; spins++) {
+        if (atomic_load_explicit(&m->state, memory_order_relaxed) == 0 &&
+            adaptive_mutex_trylock(m)) {
+            /* Move the budget toward twice what this lock needed */
+            int target = 2 * (spins + 1);
+            if (target > ADAPTIVE_MUTEX_MAX_SPINS)
+                target = ADAPTIVE_MUTEX_MAX_SPINS;
+            atomic_store_explicit(&m->spin_budget,
+                                  budget + (target - budget) / 8,
+                                  memory_order_relaxed);
+            phase = &m->stats.by_spin;
+            break;
+        }
+        adaptive_mutex_pause();
+    }
+
+    /* Yield: let the holder run if it is a ULT on our xstream */
+    if (!phase) {
+        int is_ult = adaptive_mutex_caller_is_ult();
+        for (int i = 0; i < ADAPTIVE_MUTEX_YIELDS; i++) {
+            if (is_ult)
+                ABT_thread_yield();
+            else
+                sched_yield();
+            if (adaptive_mutex_trylock(m)) {
+                phase = &m->stats.by_yield;
+                break;
+            }
+        }
+    }
+
+    /* Park until an unlock hands the mutex over */
+    if (!phase) {
+        adaptive_mutex_park(m);
+        phase = &m->stats.by_park;
+        /* Spinning did not pay off: spin less next time */
+        if (budget - budget / 8 >= m->min_spins)
+            atomic_store_explicit(&m->spin_budget, budget - budget / 8,
+                                  memory_order_relaxed);
+    }
+
+    /* Holding the lock from here: statistics need no atomics */
+    m->stats.acquisitions++;
+    m->stats.contended++;
+    (*phase)++;
+    if (m->flags & ADAPTIVE_MUTEX_TIMING) {
+        m->acquired_at = ABT_get_wtime();
+        double wait = m->acquired_at - start;
+        m->stats.wait_time += wait;
+        if (wait > m->stats.max_wait_time)
+            m->stats.max_wait_time = wait;
+    }
+}
+
+static inline void adaptive_mutex_unlock(adaptive_mutex_t *m)
+{
+    if (m->flags & ADAPTIVE_MUTEX_TIMING) {
+        double hold = ABT_get_wtime() - m->acquired_at;
+        m->stats.hold_time += hold;
+        if (hold > m->stats.max_hold_time)
+            m->stats.max_hold_time = hold;
+    }
+    int expected = 1;
+    if (atomic_compare_exchange_strong_explicit(&m->state, &expected, 0,
+                                                memory_order_release,
+                                                memory_order_relaxed))
+        return;
+
+    /* The lock word is 2: release it under park_mutex, where the parked
+     * count is exact, and we still hold the lock for the stats */
+    ABT_mutex park_mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&m->park_mutex_mem);
+    ABT_mutex_lock(park_mutex);
+    int parked = m->parked;
+    if (parked > 0)
+        m->stats.handoffs++;
+    atomic_store_explicit(&m->state, 0, memory_order_release);
+    if (parked > 0)
+        ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(&m->park_cond_mem));
+    ABT_mutex_unlock(park_mutex);
+}
+
+/* Read while no one holds the lock */
+static inline void adaptive_mutex_get_stats(adaptive_mutex_t *m,
+                                            adaptive_mutex_stats_t *stats)
+{
+    *stats = m->stats;
+}
+
+static inline void adaptive_mutex_print_stats(adaptive_mutex_t *m, FILE *out)
+{
+    adaptive_mutex_stats_t *s = &m->stats;
+    fprintf(out, "acquisitions %ld, contended %ld (spin %ld, yield %ld, "
+            "park %ld), handoffs %ld, spin budget %d\n", s->acquisitions,
+            s->contended, s->by_spin, s->by_yield, s->by_park, s->handoffs,
+            atomic_load_explicit(&m->spin_budget, memory_order_relaxed));
+    if ((m->flags & ADAPTIVE_MUTEX_TIMING) && s->acquisitions > 0) {
+        fprintf(out, "hold: avg %.2f us, max %.2f us; wait: avg %.2f us, "
+                "max %.2f us\n", s->hold_time / s->acquisitions * 1e6,
+                s->max_hold_time * 1e6,
+                s->contended ? s->wait_time / s->contended * 1e6 : 0.0,
+                s->max_wait_time * 1e6);
+    }
+}
+
+#endif /* ADAPTIVE_MUTEX_H */
@@ -0,0 +1,214 @@
+/*
+ * Bounded MPMC channel: lock-free ring buffer with parking on full/empty
+ *
+ * The ring follows Dmitry Vyukov's bounded MPMC queue: each cell carries a
+ * sequence number telling whether it is ready for the sender or for the
+ * receiver of a given position, so a send or a receive is one CAS on the
+ * head or tail counter and no lock. Any number of ULTs or external
+ * threads may send and receive.
+ *
+ * The mutex and the two condition variables are only used on the slow
+ * path: a sender that finds the channel full (or a receiver that finds it
+ * empty) registers as a waiter, retries once under the mutex and parks.
+ * The other side only takes the mutex to signal when it sees a waiter.
+ *
+ *   channel_send / channel_recv:          block while full / empty
+ *   channel_try_send / channel_try_recv:  return 0 instead of blocking
+ */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+typedef struct {
+    _Atomic size_t seq;
+    void *item;
+} channel_cell_t;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;      /* next position to send */
+    _Alignas(64) _Atomic size_t tail;      /* next position to receive */
+    _Alignas(64) channel_cell_t *cells;
+    size_t mask;
+    _Atomic int send_waiters;
+    _Atomic int recv_waiters;
+    ABT_mutex_memory mutex_mem;            /* slow path only */
+    ABT_cond_memory not_full_mem;
+    ABT_cond_memory not_empty_mem;
+} channel_t;
+
+/* Wake one parked ULT of the other side, if there is one */
+static inline void channel_wake(channel_t *ch, _Atomic int *waiters,
+                                ABT_cond_memory *cond_mem)
+{
+    /* Pairs with the fence in channel_park(): either the waiter sees our
+     * update, or we see the waiter */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiters, memory_order_relaxed) == 0)
+        return;
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&ch->mutex_mem);
+    ABT_mutex_lock(mutex);
+    ABT_cond_signal(ABT_COND_MEMORY_GET_HANDLE(cond_mem));
+    ABT_mutex_unlock(mutex);
+}
+
+/* Capacity is rounded up to a power of two */
+static inline int channel_init(channel_t *ch, size_t capacity)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+
+    memset(ch, 0, sizeof(channel_t));
+    /* aligned_alloc() needs a multiple of the alignment */
+    size_t bytes = (sizeof(channel_cell_t) * size + 63) / 64 * 64;
+    ch->cells = (channel_cell_t *)aligned_alloc(64, bytes);
+    if (!ch->cells)
+        return ABT_ERR_MEM;
+    for (size_t i = 0; i < size; i++)
+        atomic_init(&ch->cells[i].seq, i);
+    ch->mask = size - 1;
+    /* Equivalent to ABT_MUTEX_INITIALIZER / ABT_COND_INITIALIZER */
+    memset(&ch->mutex_mem, 0, sizeof(ch->mutex_mem));
+    memset(&ch->not_full_mem, 0, sizeof(ch->not_full_mem));
+    memset(&ch->not_empty_mem, 0, sizeof(ch->not_empty_mem));
+    return ABT_SUCCESS;
+}
+
+static inline void channel_destroy(channel_t *ch)
+{
+    free(ch->cells);
+}
+
+static inline size_t channel_capacity(channel_t *ch)
+{
+    return ch->mask + 1;
+}
+
+/* Ring operations, without waking anyone */
+
+static inline int channel_push(channel_t *ch, void *item)
+{
+    size_t pos = atomic_load_explicit(&ch->head, memory_order_relaxed);
+    channel_cell_t *cell;
+
+    while (1) {
+        cell = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            /* The cell is free for position pos: claim it */
+            if (atomic_compare_exchange_weak_explicit(&ch->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return 0; /* still holds the item of position pos - capacity */
+        } else {
+            pos = atomic_load_explicit(&ch->head, memory_order_relaxed);
+        }
+    }
+    cell->item = item;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+static inline int channel_pop(channel_t *ch, void **item)
+{
+    size_t pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+    channel_cell_t *cell;
+
+    while (1) {
+        cell = &ch->cells[pos & ch->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ch->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return 0; /* the sender of position pos has not written yet */
+        } else {
+            pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+        }
+    }
+    *item = cell->item;
+    /* Free the cell for the sender of position pos + capacity */
+    atomic_store_explicit(&cell->seq, pos + ch->mask + 1,
+                          memory_order_release);
+    return 1;
+}
+
+/* 1 if item was queued, 0 if the channel is full */
+static inline int channel_try_send(channel_t *ch, void *item)
+{
+    if (!channel_push(ch, item))
+        return 0;
+    channel_wake(ch, &ch->recv_waiters, &ch->not_empty_mem);
+    return 1;
+}
+
+/* 1 if an item was received into *item, 0 if the channel is empty */
+static inline int channel_try_recv(channel_t *ch, void **item)
+{
+    if (!channel_pop(ch, item))
+        return 0;
+    channel_wake(ch, &ch->send_waiters, &ch->not_full_mem);
+    return 1;
+}
+
+/* Slow path: retry under the mutex as a registered waiter, park on cond.
+ * The other side is woken by the caller, once the mutex is released. */
+static inline void channel_park(channel_t *ch, _Atomic int *waiters,
+                                ABT_cond_memory *cond_mem,
+                                int (*retry)(channel_t *, void *), void *arg)
+{
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&ch->mutex_mem);
+    ABT_cond cond = ABT_COND_MEMORY_GET_HANDLE(cond_mem);
+
+    ABT_mutex_lock(mutex);
+    atomic_fetch_add_explicit(waiters, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (!retry(ch, arg))
+        ABT_cond_wait(cond, mutex);
+    atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+    ABT_mutex_unlock(mutex);
+}
+
+static inline int channel_retry_send(channel_t *ch, void *arg)
+{
+    return channel_push(ch, arg);
+}
+
+static inline int channel_retry_recv(channel_t *ch, void *arg)
+{
+    return channel_pop(ch, (void **)arg);
+}
+
+static inline void channel_send(channel_t *ch, void *item)
+{
+    if (channel_try_send(ch, item))
+        return;
+    channel_park(ch, &ch->send_waiters, &ch->not_full_mem, channel_retry_send,
+                 item);
+    channel_wake(ch, &ch->recv_waiters, &ch->not_empty_mem);
+}
+
+static inline void *channel_recv(channel_t *ch)
+{
+    void *item;
+    if (channel_try_recv(ch, &item))
+        return item;
+    channel_park(ch, &ch->recv_waiters, &ch->not_empty_mem, channel_retry_recv,
+                 &item);
+    channel_wake(ch, &ch->send_waiters, &ch->not_full_mem);
+    return item;
+}
+
+#endif /* CHANNEL_H */
@@ -0,0 +1,270 @@
+/*
+ * Channel benchmark: lock-free channel vs mutex + condition variables
+ *
+ * The mutex version is the ring buffer of producer_consumer.c (one
+ * ABT_mutex, two ABT_conds, a signal per item) without the printf calls.
+ * The channel version uses channel.h. Producer and consumer ULTs share
+ * one pool served by x xstreams; every item carries its send time, and
+ * the consumer records the send-to-receive latency.
+ *
+ * Usage: 07_abt_channel_benchmark [-x xstreams] [-n items] [-p producers,...]
+ *                                 [-c consumers,...] [-s buffer_size,...]
+ *   every combination of producer count, consumer count and buffer size
+ *   is run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+#include "channel.h"
+
+#define NUM_XSTREAMS 4
+#define NUM_ITEMS 1000000
+#define PRODUCERS "1,4"
+#define CONSUMERS "1,4"
+#define BUFFER_SIZES "4,64,1024"
+#define MAX_VALUES 16
+
+typedef struct {
+    int *buffer;
+    int size;
+    int count;
+    int in;
+    int out;
+    ABT_mutex mutex;
+    ABT_cond not_full;
+    ABT_cond not_empty;
+} shared_buffer_t;
+
+typedef struct {
+    int use_channel;
+    shared_buffer_t buf;
+    channel_t ch;
+    double *send_time;         /* indexed by item */
+    double *latency;
+} bench_t;
+
+typedef struct {
+    bench_t *bench;
+    int first;                 /* producers send items [first, last) */
+    int last;                  /* consumers receive last - first items */
+} worker_arg_t;
+
+void buffer_put(shared_buffer_t *buf, int item)
+{
+    ABT_mutex_lock(buf->mutex);
+    while (buf->count == buf->size)
+        ABT_cond_wait(buf->not_full, buf->mutex);
+    buf->buffer[buf->in] = item;
+    buf->in = (buf->in + 1) % buf->size;
+    buf->count++;
+    ABT_cond_signal(buf->not_empty);
+    ABT_mutex_unlock(buf->mutex);
+}
+
+int buffer_get(shared_buffer_t *buf)
+{
+    ABT_mutex_lock(buf->mutex);
+    while (buf->count == 0)
+        ABT_cond_wait(buf->not_empty, buf->mutex);
+    int item = buf->buffer[buf->out];
+    buf->out = (buf->out + 1) % buf->size;
+    buf->count--;
+    ABT_cond_signal(buf->not_full);
+    ABT_mutex_unlock(buf->mutex);
+    return item;
+}
+
+void producer(void *arg)
+{
+    worker_arg_t *worker = (worker_arg_t *)arg;
+    bench_t *b = worker->bench;
+
+    for (int item = worker->first; item < worker->last; item++) {
+        b->send_time[item] = ABT_get_wtime();
+        if (b->use_channel)
+            channel_send(&b->ch, (void *)(intptr_t)item);
+        else
+            buffer_put(&b->buf, item);
+    }
+}
+
+void consumer(void *arg)
+{
+    worker_arg_t *worker = (worker_arg_t *)arg;
+    bench_t *b = worker->bench;
+
+    for (int i = worker->first; i < worker->last; i++) {
+        int item;
+        if (b->use_channel)
+            item = (int)(intptr_t)channel_recv(&b->ch);
+        else
+            item = buffer_get(&b->buf);
+        b->latency[item] = ABT_get_wtime() - b->send_time[item];
+    }
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Runs one configuration and prints its line */
+void run(int use_channel, int num_xstreams, int num_items, int num_producers,
+         int num_consumers, int buffer_size, double *send_time,
+         double *latency)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) *
+                                 (num_producers + num_consumers));
+    worker_arg_t *args = malloc(sizeof(worker_arg_t) *
+                                (num_producers + num_consumers));
+    bench_t bench;
+    ABT_pool pool;
+
+    ABT_init(0, NULL);
+
+    memset(&bench, 0, sizeof(bench));
+    bench.use_channel = use_channel;
+    bench.send_time = send_time;
+    bench.latency = latency;
+    if (use_channel) {
+        if (channel_init(&bench.ch, buffer_size) != ABT_SUCCESS) {
+            fprintf(stderr, "Error: cannot allocate a channel of %d items\n",
+                    buffer_size);
+            exit(1);
+        }
+    } else {
+        bench.buf.buffer = malloc(sizeof(int) * buffer_size);
+        if (!bench.buf.buffer) {
+            fprintf(stderr, "Error: cannot allocate a buffer of %d items\n",
+                    buffer_size);
+            exit(1);
+        }
+        bench.buf.size = buffer_size;
+        ABT_mutex_create(&bench.buf.mutex);
+        ABT_cond_create(&bench.buf.not_full);
+        ABT_cond_create(&bench.buf.not_empty);
+    }
+
+    ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                          &pool);
+    for (int i = 0; i < num_producers + num_consumers; i++) {
+        int is_producer = i < num_producers;
+        int rank = is_producer ? i : i - num_producers;
+        int num = is_producer ? num_producers : num_consumers;
+        args[i].bench = &bench;
+        args[i].first = (int)((long)num_items * rank / num);
+        args[i].last = (int)((long)num_items * (rank + 1) / num);
+        ABT_thread_create(pool, is_producer ? producer : consumer, &args[i],
+                          ABT_THREAD_ATTR_NULL, &threads[i]);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pool,
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_producers + num_consumers; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    if (use_channel) {
+        channel_destroy(&bench.ch);
+    } else {
+        ABT_cond_free(&bench.buf.not_empty);
+        ABT_cond_free(&bench.buf.not_full);
+        ABT_mutex_free(&bench.buf.mutex);
+        free(bench.buf.buffer);
+    }
+    ABT_finalize();
+
+    qsort(latency, num_items, sizeof(double), compare_double);
+    printf("%-5d %-5d %-7d %-8s %14.0f %10.2f %10.2f %10.2f\n", num_producers,
+           num_consumers, buffer_size, use_channel ? "channel" : "mutex",
+           num_items / elapsed, latency[num_items / 2] * 1e6,
+           latency[(int)(num_items * 0.99)] * 1e6,
+           latency[num_items - 1] * 1e6);
+
+    free(args);
+    free(threads);
+    free(xstreams);
+}
+
+int parse_list(const char *arg, int *values)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < 1)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_items = NUM_ITEMS;
+    int producers[MAX_VALUES], num_p = parse_list(PRODUCERS, producers);
+    int consumers[MAX_VALUES], num_c = parse_list(CONSUMERS, consumers);
+    int sizes[MAX_VALUES], num_s = parse_list(BUFFER_SIZES, sizes);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:p:c:s:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_items = atoi(optarg); break;
+            case 'p': num_p = parse_list(optarg, producers); break;
+            case 'c': num_c = parse_list(optarg, consumers); break;
+            case 's': num_s = parse_list(optarg, sizes); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n items] "
+                        "[-p producers,...] [-c consumers,...] "
+                        "[-s buffer_size,...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_items < 1 || !num_p || !num_c || !num_s) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    double *send_time = malloc(sizeof(double) * num_items);
+    double *latency = malloc(sizeof(double) * num_items);
+
+    printf("=== Channel Benchmark ===\n");
+    printf("%d xstreams, %d items\n\n", num_xstreams, num_items);
+    printf("%-5s %-5s %-7s %-8s %14s %10s %10s %10s\n", "prod", "cons",
+           "buffer", "version", "items/s", "p50(us)", "p99(us)", "max(us)");
+
+    for (int p = 0; p < num_p; p++) {
+        for (int c = 0; c < num_c; c++) {
+            for (int s = 0; s < num_s; s++) {
+                run(0, num_xstreams, num_items, producers[p], consumers[c],
+                    sizes[s], send_time, latency);
+                run(1, num_xstreams, num_items, producers[p], consumers[c],
+                    sizes[s], send_time, latency);
+            }
+        }
+    }
+
+    printf("\nLatency: from the send call to the return of the receive\n");
+    printf("The channel rounds buffer sizes up to a power of two\n");
+
+    free(latency);
+    free(send_time);
+    return 0;
+}
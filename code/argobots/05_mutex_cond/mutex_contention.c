@@ -0,0 +1,229 @@
+/*
+ * Mutex contention benchmark: stock ABT_mutex vs the adaptive mutex
+ *
+ * u ULTs (on a pool served by x xstreams) and p pthreads increment a shared
+ * counter n times each, holding the mutex for a busy-wait of l nanoseconds
+ * per increment. Every combination of caller mix and critical-section
+ * length is run with both mutexes; the adaptive mutex also reports how its
+ * contended acquisitions were resolved (spin, yield or park) and, with -t,
+ * its average hold and wait times.
+ *
+ * Usage: 07_abt_mutex_contention [-x xstreams] [-n ops] [-l cs_ns,...]
+ *                                [-m ults:pthreads,...] [-t]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <abt.h>
+#include "adaptive_mutex.h"
+
+#define NUM_XSTREAMS 4
+#define NUM_OPS 100000
+#define CS_LENGTHS "0,100,1000,10000"
+#define CALLER_MIXES "8:0,4:4,0:8"
+#define MAX_VALUES 16
+
+typedef struct {
+    int use_adaptive;
+    int num_ops;
+    double cs_ns;
+    long counter;
+    ABT_mutex mutex;
+    adaptive_mutex_t amutex;
+} bench_t;
+
+/* Busy critical section: a ULT holding a mutex should not yield */
+void critical_section(double ns)
+{
+    if (ns <= 0.0)
+        return;
+    double end = ABT_get_wtime() + ns * 1e-9;
+    while (ABT_get_wtime() < end)
+        ;
+}
+
+void worker(void *arg)
+{
+    bench_t *b = (bench_t *)arg;
+
+    for (int i = 0; i < b->num_ops; i++) {
+        if (b->use_adaptive) {
+            adaptive_mutex_lock(&b->amutex);
+            b->counter++;
+            critical_section(b->cs_ns);
+            adaptive_mutex_unlock(&b->amutex);
+        } else {
+            ABT_mutex_lock(b->mutex);
+            b->counter++;
+            critical_section(b->cs_ns);
+            ABT_mutex_unlock(b->mutex);
+        }
+    }
+}
+
+void *pthread_worker(void *arg)
+{
+    worker(arg);
+    return NULL;
+}
+
+/* Runs one configuration and prints its line */
+void run(int use_adaptive, int timing, int num_xstreams, int num_ops,
+         int num_ults, int num_pthreads, int cs_ns)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * (num_ults + 1));
+    pthread_t *pthreads = malloc(sizeof(pthread_t) * (num_pthreads + 1));
+    bench_t bench;
+    ABT_pool pool;
+
+    ABT_init(0, NULL);
+
+    memset(&bench, 0, sizeof(bench));
+    bench.use_adaptive = use_adaptive;
+    bench.num_ops = num_ops;
+    bench.cs_ns = cs_ns;
+    if (use_adaptive)
+        adaptive_mutex_init(&bench.amutex, timing ? ADAPTIVE_MUTEX_TIMING : 0);
+    else
+        ABT_mutex_create(&bench.mutex);
+
+    ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                          &pool);
+    for (int i = 0; i < num_ults; i++) {
+        ABT_thread_create(pool, worker, &bench, ABT_THREAD_ATTR_NULL,
+                          &threads[i]);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pool,
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_pthreads; i++) {
+        pthread_create(&pthreads[i], NULL, pthread_worker, &bench);
+    }
+    for (int i = 0; i < num_ults; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    for (int i = 0; i < num_pthreads; i++) {
+        pthread_join(pthreads[i], NULL);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+
+    long total = (long)num_ops * (num_ults + num_pthreads);
+    printf("%4d:%-4d %8d %-9s %12.0f", num_ults, num_pthreads, cs_ns,
+           use_adaptive ? "adaptive" : "stock", total / elapsed);
+    if (use_adaptive) {
+        adaptive_mutex_stats_t s;
+        adaptive_mutex_get_stats(&bench.amutex, &s);
+        double pct = s.acquisitions ? 100.0 / s.acquisitions : 0.0;
+        printf(" %7.1f %7.1f %7.1f %7.1f %9ld", s.contended * pct,
+               s.by_spin * pct, s.by_yield * pct, s.by_park * pct,
+               s.handoffs);
+        if (timing) {
+            printf(" %9.2f %9.2f", s.hold_time / s.acquisitions * 1e6,
+                   s.contended ? s.wait_time / s.contended * 1e6 : 0.0);
+        }
+    } else {
+        ABT_mutex_free(&bench.mutex);
+    }
+    printf("%s\n", bench.counter == total ? "" : "  WRONG COUNT");
+    ABT_finalize();
+
+    free(pthreads);
+    free(threads);
+    free(xstreams);
+}
+
+int parse_list(const char *arg, int *values)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < 0)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+/* Parses "ults:pthreads,..." */
+int parse_mixes(const char *arg, int *ults, int *pthreads)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        if (sscanf(tok, "%d:%d", &ults[num], &pthreads[num]) != 2 ||
+            ults[num] < 0 || pthreads[num] < 0 ||
+            ults[num] + pthreads[num] < 1)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_ops = NUM_OPS;
+    int timing = 0;
+    int lengths[MAX_VALUES], num_l = parse_list(CS_LENGTHS, lengths);
+    int ults[MAX_VALUES], pthreads[MAX_VALUES];
+    int num_m = parse_mixes(CALLER_MIXES, ults, pthreads);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:l:m:t")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_ops = atoi(optarg); break;
+            case 'l': num_l = parse_list(optarg, lengths); break;
+            case 'm': num_m = parse_mixes(optarg, ults, pthreads); break;
+            case 't': timing = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n ops] "
+                        "[-l cs_ns,...] [-m ults:pthreads,...] [-t]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_ops < 1 || !num_l || !num_m) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Mutex Contention Benchmark ===\n");
+    printf("%d xstreams, %d operations per caller%s\n\n", num_xstreams,
+           num_ops, timing ? ", timing on" : "");
+    printf("%-9s %8s %-9s %12s %7s %7s %7s %7s %9s", "ult:pth", "cs(ns)",
+           "mutex", "ops/s", "cont%", "spin%", "yield%", "park%",
+           "handoffs");
+    if (timing)
+        printf(" %9s %9s", "hold(us)", "wait(us)");
+    printf("\n");
+
+    for (int m = 0; m < num_m; m++) {
+        for (int l = 0; l < num_l; l++) {
+            run(0, timing, num_xstreams, num_ops, ults[m], pthreads[m],
+                lengths[l]);
+            run(1, timing, num_xstreams, num_ops, ults[m], pthreads[m],
+                lengths[l]);
+        }
+    }
+
+    printf("\nPercentages are of all acquisitions of the adaptive mutex\n");
+    return 0;
+}
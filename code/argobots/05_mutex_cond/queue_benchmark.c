@@ -0,0 +1,206 @@
+/*
+ * Queue benchmark: yield-spinning vs blocking vs batched queue operations
+ *
+ * Producer and consumer ULTs share one pool served by x xstreams and move
+ * n items through the queue of shared_queue.h:
+ *   yield:    queue_try_push/queue_try_pop, ABT_thread_yield() and retry
+ *             while full/empty (the loop shared_queue.c used to have)
+ *   blocking: queue_push/queue_pop, which park the ULT while full/empty
+ *   batched:  queue_push_n/queue_pop_n with batches of b items
+ * Besides the throughput, the CPU time of the process shows the cost of
+ * spinning: the xstreams use ABT_SCHED_BASIC_WAIT and sleep when their
+ * pool is empty, but yielding ULTs never leave the pool, so they keep
+ * every xstream busy even when the queue is full or empty. The primary
+ * xstream also runs ABT_SCHED_BASIC_WAIT, so it sleeps while its ULT waits
+ * in ABT_thread_free() instead of adding a core per second of wall time.
+ *
+ * Usage: 07_abt_queue_benchmark [-x xstreams] [-n items] [-p producers]
+ *                               [-c consumers] [-q capacity] [-b batch]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <abt.h>
+#include "shared_queue.h"
+
+#define NUM_XSTREAMS 4
+#define NUM_ITEMS 1000000
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define QUEUE_SIZE 64
+#define BATCH 16
+
+enum { MODE_YIELD, MODE_BLOCKING, MODE_BATCHED, NUM_MODES };
+static const char *mode_names[NUM_MODES] = {"yield", "blocking", "batched"};
+
+typedef struct {
+    thread_safe_queue_t *queue;
+    int mode;
+    int batch;
+    int first;                 /* producers push items [first, last) */
+    int last;                  /* consumers pop last - first items */
+} worker_arg_t;
+
+void producer(void *arg)
+{
+    worker_arg_t *w = (worker_arg_t *)arg;
+    int *items = malloc(sizeof(int) * w->batch);
+
+    for (int item = w->first; item < w->last;) {
+        if (w->mode == MODE_YIELD) {
+            while (queue_try_push(w->queue, item) != 0)
+                ABT_thread_yield();
+            item++;
+        } else if (w->mode == MODE_BLOCKING) {
+            queue_push(w->queue, item++);
+        } else {
+            int n = w->last - item < w->batch ? w->last - item : w->batch;
+            for (int i = 0; i < n; i++)
+                items[i] = item++;
+            queue_push_n(w->queue, items, n);
+        }
+    }
+    free(items);
+}
+
+void consumer(void *arg)
+{
+    worker_arg_t *w = (worker_arg_t *)arg;
+    int *items = malloc(sizeof(int) * w->batch);
+    int remaining = w->last - w->first;
+
+    while (remaining > 0) {
+        if (w->mode == MODE_YIELD) {
+            while (queue_try_pop(w->queue, &items[0]) != 0)
+                ABT_thread_yield();
+            remaining--;
+        } else if (w->mode == MODE_BLOCKING) {
+            items[0] = queue_pop(w->queue);
+            remaining--;
+        } else {
+            remaining -= queue_pop_n(w->queue, items, remaining < w->batch
+                                                      ? remaining
+                                                      : w->batch);
+        }
+    }
+    free(items);
+}
+
+double cpu_seconds(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+void run(int mode, int num_xstreams, int num_items, int num_producers,
+         int num_consumers, int capacity, int batch)
+{
+    int num_workers = num_producers + num_consumers;
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_workers);
+    worker_arg_t *args = malloc(sizeof(worker_arg_t) * num_workers);
+    thread_safe_queue_t queue;
+    ABT_pool pool, main_pool;
+    ABT_xstream self;
+
+    ABT_init(0, NULL);
+    queue_init(&queue, capacity);
+
+    /* The primary xstream only waits: let it sleep as well */
+    ABT_pool_create_basic(ABT_POOL_FIFO_WAIT, ABT_POOL_ACCESS_MPSC, ABT_TRUE,
+                          &main_pool);
+    ABT_xstream_self(&self);
+    ABT_xstream_set_main_sched_basic(self, ABT_SCHED_BASIC_WAIT, 1,
+                                     &main_pool);
+
+    /* Idle xstreams sleep, so only spinning ULTs use CPU time */
+    ABT_pool_create_basic(ABT_POOL_FIFO_WAIT, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                          &pool);
+    for (int i = 0; i < num_workers; i++) {
+        int is_producer = i < num_producers;
+        int rank = is_producer ? i : i - num_producers;
+        int num = is_producer ? num_producers : num_consumers;
+        args[i].queue = &queue;
+        args[i].mode = mode;
+        args[i].batch = batch;
+        args[i].first = (int)((long)num_items * rank / num);
+        args[i].last = (int)((long)num_items * (rank + 1) / num);
+        ABT_thread_create(pool, is_producer ? producer : consumer, &args[i],
+                          ABT_THREAD_ATTR_NULL, &threads[i]);
+    }
+
+    double cpu_start = cpu_seconds();
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC_WAIT, 1, &pool,
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_workers; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+    double cpu = cpu_seconds() - cpu_start;
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    queue_destroy(&queue);
+    ABT_finalize();
+
+    printf("%-10s %14.0f %10.3f %10.3f %12.1f\n", mode_names[mode],
+           num_items / elapsed, elapsed, cpu, cpu / num_items * 1e9);
+
+    free(args);
+    free(threads);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int num_items = NUM_ITEMS;
+    int num_producers = NUM_PRODUCERS;
+    int num_consumers = NUM_CONSUMERS;
+    int capacity = QUEUE_SIZE;
+    int batch = BATCH;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:p:c:q:b:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n': num_items = atoi(optarg); break;
+            case 'p': num_producers = atoi(optarg); break;
+            case 'c': num_consumers = atoi(optarg); break;
+            case 'q': capacity = atoi(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-n items] "
+                        "[-p producers] [-c consumers] [-q capacity] "
+                        "[-b batch]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || num_items < 1 || num_producers < 1 ||
+        num_consumers < 1 || capacity < 1 || batch < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Queue Benchmark ===\n");
+    printf("%d xstreams, %d producers, %d consumers, %d items, "
+           "capacity %d, batch %d\n\n", num_xstreams, num_producers,
+           num_consumers, num_items, capacity, batch);
+    printf("%-10s %14s %10s %10s %12s\n", "mode", "items/s", "wall(s)",
+           "cpu(s)", "cpu ns/item");
+
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+        run(mode, num_xstreams, num_items, num_producers, num_consumers,
+            capacity, batch);
+    }
+    return 0;
+}
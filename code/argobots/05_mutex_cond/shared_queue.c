@@ -1,84 +1,19 @@
 /*
  * Thread-safe queue implementation with mutexes using static initialization
  * Demonstrates ABT_mutex_memory to avoid heap allocation
+ * Workers block on the queue's condition variables instead of yielding
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <abt.h>
+#include "shared_queue.h"
 
 #define QUEUE_SIZE 10
 #define NUM_WORKERS 4
 #define ITEMS_PER_WORKER 5
 
-typedef struct {
-    int *data;
-    int capacity;
-    int size;
-    int head;
-    int tail;
-    ABT_mutex_memory mutex_mem;  /* Static mutex memory */
-} thread_safe_queue_t;
-
-void queue_init(thread_safe_queue_t *q, int capacity)
-{
-    q->data = malloc(sizeof(int) * capacity);
-    q->capacity = capacity;
-    q->size = 0;
-    q->head = 0;
-    q->tail = 0;
-    /* Initialize mutex memory
-     * This is equivalent to setting it to ABT_MUTEX_INITIALIZER */
-    memset(&q->mutex_mem, 0, sizeof(q->mutex_mem));
-}
-
-int queue_push(thread_safe_queue_t *q, int value)
-{
-    /* Convert mutex_memory to ABT_mutex handle */
-    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
-
-    ABT_mutex_lock(mutex);
-
-    if (q->size == q->capacity) {
-        ABT_mutex_unlock(mutex);
-        return -1;  /* Queue full */
-    }
-
-    q->data[q->tail] = value;
-    q->tail = (q->tail + 1) % q->capacity;
-    q->size++;
-
-    ABT_mutex_unlock(mutex);
-    return 0;
-}
-
-int queue_pop(thread_safe_queue_t *q, int *value)
-{
-    /* Convert mutex_memory to ABT_mutex handle */
-    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
-
-    ABT_mutex_lock(mutex);
-
-    if (q->size == 0) {
-        ABT_mutex_unlock(mutex);
-        return -1;  /* Queue empty */
-    }
-
-    *value = q->data[q->head];
-    q->head = (q->head + 1) % q->capacity;
-    q->size--;
-
-    ABT_mutex_unlock(mutex);
-    return 0;
-}
-
-void queue_destroy(thread_safe_queue_t *q)
-{
-    /* No need to free mutex_mem - no heap allocation */
-    free(q->data);
-}
-
 typedef struct {
     int worker_id;
     thread_safe_queue_t *queue;
@@ -87,29 +22,24 @@ typedef struct {
 void worker_thread(void *arg)
 {
     worker_arg_t *worker = (worker_arg_t *)arg;
+    int items[ITEMS_PER_WORKER];
 
-    /* Each worker pushes some items */
+    /* Each worker pushes its items in one operation (blocks while full) */
     for (int i = 0; i < ITEMS_PER_WORKER; i++) {
-        int item = worker->worker_id * 100 + i;
-
-        while (queue_push(worker->queue, item) != 0) {
-            /* Queue full, yield and retry */
-            ABT_thread_yield();
-        }
-
-        printf("Worker %d: pushed %d\n", worker->worker_id, item);
+        items[i] = worker->worker_id * 100 + i;
     }
-
-    /* Then pop some items */
-    for (int i = 0; i < ITEMS_PER_WORKER; i++) {
-        int item;
-
-        while (queue_pop(worker->queue, &item) != 0) {
-            /* Queue empty, yield and retry */
-            ABT_thread_yield();
+    queue_push_n(worker->queue, items, ITEMS_PER_WORKER);
+    printf("Worker %d: pushed %d items\n", worker->worker_id,
+           ITEMS_PER_WORKER);
+
+    /* Then pops as many items (blocks while empty) */
+    for (int popped = 0; popped < ITEMS_PER_WORKER;) {
+        int n = queue_pop_n(worker->queue, items,
+                            ITEMS_PER_WORKER - popped);
+        for (int i = 0; i < n; i++) {
+            printf("  Worker %d: popped %d\n", worker->worker_id, items[i]);
         }
-
-        printf("  Worker %d: popped %d\n", worker->worker_id, item);
+        popped += n;
     }
 }
 
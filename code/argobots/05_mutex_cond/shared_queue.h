@@ -0,0 +1,178 @@
+/*
+ * Thread-safe bounded queue with blocking and batched operations
+ * Uses ABT_mutex_memory and ABT_cond_memory: no heap allocation for them
+ *
+ * queue_push/queue_pop block while the queue is full/empty: the ULT parks
+ * on a condition variable and is woken when its operation can proceed,
+ * instead of yielding in a loop. The queue counts its waiters, so an
+ * operation that makes room for k items (or adds k items) signals at most
+ * k waiters, and none when nobody waits.
+ *
+ * queue_push_n/queue_pop_n move many items per lock acquisition.
+ * queue_try_push/queue_try_pop never block and return -1 when full/empty.
+ */
+
+#ifndef SHARED_QUEUE_H
+#define SHARED_QUEUE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <abt.h>
+
+typedef struct {
+    int *data;
+    int capacity;
+    int size;
+    int head;
+    int tail;
+    int push_waiters;          /* ULTs waiting on not_full */
+    int pop_waiters;           /* ULTs waiting on not_empty */
+    ABT_mutex_memory mutex_mem;  /* Static mutex memory */
+    ABT_cond_memory not_full_mem;
+    ABT_cond_memory not_empty_mem;
+} thread_safe_queue_t;
+
+static inline void queue_init(thread_safe_queue_t *q, int capacity)
+{
+    q->data = malloc(sizeof(int) * capacity);
+    q->capacity = capacity;
+    q->size = 0;
+    q->head = 0;
+    q->tail = 0;
+    q->push_waiters = 0;
+    q->pop_waiters = 0;
+    /* Initialize mutex and condition memory
+     * This is equivalent to setting them to ABT_MUTEX_INITIALIZER and
+     * ABT_COND_INITIALIZER */
+    memset(&q->mutex_mem, 0, sizeof(q->mutex_mem));
+    memset(&q->not_full_mem, 0, sizeof(q->not_full_mem));
+    memset(&q->not_empty_mem, 0, sizeof(q->not_empty_mem));
+}
+
+static inline void queue_destroy(thread_safe_queue_t *q)
+{
+    /* No need to free mutex_mem or cond memory - no heap allocation */
+    free(q->data);
+}
+
+/* Wake up to num waiters of cond; called with the mutex held */
+static inline void queue_wake(ABT_cond_memory *cond_mem, int waiters,
+                              int num)
+{
+    ABT_cond cond = ABT_COND_MEMORY_GET_HANDLE(cond_mem);
+
+    if (waiters == 0 || num == 0)
+        return;
+    if (num >= waiters) {
+        ABT_cond_broadcast(cond);
+    } else {
+        for (int i = 0; i < num; i++)
+            ABT_cond_signal(cond);
+    }
+}
+
+/* Copy up to num items in; called with the mutex held */
+static inline int queue_put_locked(thread_safe_queue_t *q, const int *values,
+                                   int num)
+{
+    int n = q->capacity - q->size;
+    if (n > num)
+        n = num;
+    for (int i = 0; i < n; i++) {
+        q->data[q->tail] = values[i];
+        q->tail = (q->tail + 1) % q->capacity;
+    }
+    q->size += n;
+    queue_wake(&q->not_empty_mem, q->pop_waiters, n);
+    return n;
+}
+
+/* Copy up to num items out; called with the mutex held */
+static inline int queue_get_locked(thread_safe_queue_t *q, int *values,
+                                   int num)
+{
+    int n = q->size < num ? q->size : num;
+    for (int i = 0; i < n; i++) {
+        values[i] = q->data[q->head];
+        q->head = (q->head + 1) % q->capacity;
+    }
+    q->size -= n;
+    queue_wake(&q->not_full_mem, q->push_waiters, n);
+    return n;
+}
+
+static inline int queue_try_push(thread_safe_queue_t *q, int value)
+{
+    /* Convert mutex_memory to ABT_mutex handle */
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
+
+    ABT_mutex_lock(mutex);
+    int n = queue_put_locked(q, &value, 1);
+    ABT_mutex_unlock(mutex);
+    return n == 1 ? 0 : -1;  /* -1: queue full */
+}
+
+static inline int queue_try_pop(thread_safe_queue_t *q, int *value)
+{
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
+
+    ABT_mutex_lock(mutex);
+    int n = queue_get_locked(q, value, 1);
+    ABT_mutex_unlock(mutex);
+    return n == 1 ? 0 : -1;  /* -1: queue empty */
+}
+
+/* Push all num values, blocking while the queue is full */
+static inline void queue_push_n(thread_safe_queue_t *q, const int *values,
+                                int num)
+{
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
+    ABT_cond not_full = ABT_COND_MEMORY_GET_HANDLE(&q->not_full_mem);
+
+    ABT_mutex_lock(mutex);
+    while (1) {
+        int n = queue_put_locked(q, values, num);
+        values += n;
+        num -= n;
+        if (num == 0)
+            break;
+        /* Queue full: sleep until a pop makes room */
+        q->push_waiters++;
+        ABT_cond_wait(not_full, mutex);
+        q->push_waiters--;
+    }
+    ABT_mutex_unlock(mutex);
+}
+
+/* Pop between 1 and max values, blocking while the queue is empty;
+ * returns the number of values popped */
+static inline int queue_pop_n(thread_safe_queue_t *q, int *values, int max)
+{
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&q->mutex_mem);
+    ABT_cond not_empty = ABT_COND_MEMORY_GET_HANDLE(&q->not_empty_mem);
+
+    ABT_mutex_lock(mutex);
+    while (q->size == 0) {
+        /* Queue empty: sleep until a push adds an item */
+        q->pop_waiters++;
+        ABT_cond_wait(not_empty, mutex);
+        q->pop_waiters--;
+    }
+    int n = queue_get_locked(q, values, max);
+    ABT_mutex_unlock(mutex);
+    return n;
+}
+
+static inline void queue_push(thread_safe_queue_t *q, int value)
+{
+    queue_push_n(q, &value, 1);
+}
+
+static inline int queue_pop(thread_safe_queue_t *q)
+{
+    int value;
+    queue_pop_n(q, &value, 1);
+    return value;
+}
+
+#endif /* SHARED_QUEUE_H */
@@ -0,0 +1,150 @@
+/*
+ * Broadcast eventual: an eventual optimized for many waiters
+ *
+ * ABT_eventual_set() copies the value into the eventual and then wakes the
+ * waiters one by one from the setter, so with thousands of waiters the
+ * last one resumes long after the set. This eventual differs in two ways:
+ *   - the value is passed by pointer: bcast_eventual_set() stores the
+ *     pointer, and every waiter gets it back; nothing is copied, so the
+ *     value must stay valid as long as waiters may read it
+ *   - waiters register on the shard of their xstream (one mutex and
+ *     condition variable per rank, external threads share an extra one),
+ *     and the setter hands each shard back to the pool its waiters came
+ *     from: it pushes one tasklet per shard into that pool, and the tasklet
+ *     wakes the whole shard with one ABT_cond_broadcast(). When each
+ *     xstream has a pool of its own, the tasklet runs on the waiters' own
+ *     xstream and the shards are woken in parallel; with a pool shared by
+ *     several xstreams, any of them may run it. Either way, registering
+ *     waiters on different xstreams never contend
+ * The waiters' pools must accept pushes from the setter's xstream (not
+ * ABT_POOL_ACCESS_PRIV / SPSC); a shard without a pool (external threads)
+ * is woken by the setter itself.
+ *
+ * A waiter increments the waiter count of its shard, then checks the
+ * ready flag; the setter raises the flag, then reads the waiter counts.
+ * Both are sequentially consistent, so the setter cannot miss a waiter
+ * that would miss the flag.
+ */
+
+#ifndef BCAST_EVENTUAL_H
+#define BCAST_EVENTUAL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+typedef struct {
+    _Alignas(64) _Atomic int num_waiters;
+    ABT_pool home_pool;        /* pool of the first waiter, for the wakeup */
+    ABT_mutex_memory mutex_mem;
+    ABT_cond_memory cond_mem;
+} bcast_shard_t;
+
+typedef struct {
+    _Atomic int ready;
+    void *value;
+    int num_shards;            /* xstream shards, plus one for others */
+    bcast_shard_t *shards;
+} bcast_eventual_t;
+
+/* num_xstreams: ranks below it get a shard of their own */
+static inline int bcast_eventual_init(bcast_eventual_t *ev, int num_xstreams)
+{
+    if (num_xstreams < 1)
+        return ABT_ERR_INV_ARG;
+    ev->shards = aligned_alloc(64, sizeof(bcast_shard_t) * (num_xstreams + 1));
+    if (!ev->shards)
+        return ABT_ERR_MEM;
+    ev->num_shards = num_xstreams;
+    ev->value = NULL;
+    atomic_init(&ev->ready, 0);
+    for (int i = 0; i <= num_xstreams; i++) {
+        bcast_shard_t *shard = &ev->shards[i];
+        atomic_init(&shard->num_waiters, 0);
+        shard->home_pool = ABT_POOL_NULL;
+        /* Equivalent to ABT_MUTEX_INITIALIZER / ABT_COND_INITIALIZER */
+        memset(&shard->mutex_mem, 0, sizeof(shard->mutex_mem));
+        memset(&shard->cond_mem, 0, sizeof(shard->cond_mem));
+    }
+    return ABT_SUCCESS;
+}
+
+static inline void bcast_eventual_destroy(bcast_eventual_t *ev)
+{
+    free(ev->shards);
+    ev->shards = NULL;
+}
+
+/* Blocks until the eventual is set; returns the value given to the set */
+static inline void *bcast_eventual_wait(bcast_eventual_t *ev)
+{
+    if (atomic_load_explicit(&ev->ready, memory_order_acquire))
+        return ev->value;
+
+    int rank;
+    bcast_shard_t *shard;
+    if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS)
+        shard = &ev->shards[ev->num_shards];    /* external thread */
+    else
+        shard = &ev->shards[rank % ev->num_shards];
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&shard->mutex_mem);
+
+    ABT_mutex_lock(mutex);
+    if (shard->home_pool == ABT_POOL_NULL &&
+        ABT_self_get_last_pool(&shard->home_pool) != ABT_SUCCESS)
+        shard->home_pool = ABT_POOL_NULL;
+    atomic_fetch_add(&shard->num_waiters, 1);
+    while (!atomic_load(&ev->ready))
+        ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&shard->cond_mem), mutex);
+    ABT_mutex_unlock(mutex);
+    return ev->value;
+}
+
+/* Tasklet: wakes the waiters of one shard */
+static inline void bcast_eventual_wake(void *arg)
+{
+    bcast_shard_t *shard = (bcast_shard_t *)arg;
+    ABT_mutex mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&shard->mutex_mem);
+
+    /* Waiters check the flag under the mutex before they wait */
+    ABT_mutex_lock(mutex);
+    ABT_cond_broadcast(ABT_COND_MEMORY_GET_HANDLE(&shard->cond_mem));
+    ABT_mutex_unlock(mutex);
+}
+
+static inline void bcast_eventual_set(bcast_eventual_t *ev, void *value)
+{
+    ev->value = value;
+    atomic_store(&ev->ready, 1);
+
+    for (int i = 0; i <= ev->num_shards; i++) {
+        bcast_shard_t *shard = &ev->shards[i];
+        if (atomic_load(&shard->num_waiters) == 0)
+            continue;
+        /* The first waiter set home_pool before counting itself */
+        if (shard->home_pool == ABT_POOL_NULL ||
+            ABT_task_create(shard->home_pool, bcast_eventual_wake, shard,
+                            NULL) != ABT_SUCCESS)
+            bcast_eventual_wake(shard);
+    }
+}
+
+static inline int bcast_eventual_test(bcast_eventual_t *ev)
+{
+    return atomic_load_explicit(&ev->ready, memory_order_acquire);
+}
+
+/* Only when no ULT is waiting, as for ABT_eventual_reset() */
+static inline void bcast_eventual_reset(bcast_eventual_t *ev)
+{
+    atomic_store(&ev->ready, 0);
+    ev->value = NULL;
+    for (int i = 0; i <= ev->num_shards; i++) {
+        atomic_store(&ev->shards[i].num_waiters, 0);
+        /* The next waiters may come from other pools; this one may be freed */
+        ev->shards[i].home_pool = ABT_POOL_NULL;
+    }
+}
+
+#endif /* BCAST_EVENTUAL_H */
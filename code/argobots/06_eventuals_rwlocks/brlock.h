@@ -0,0 +1,134 @@
+/*
+ * Big reader lock: a reader-writer lock distributed over xstreams
+ *
+ * Every reader of an ABT_rwlock updates the same lock word, so its cache
+ * line moves between the cores even when no writer ever shows up. Here,
+ * each xstream has its own reader count on its own cache line (indexed by
+ * ABT_xstream_self_rank(); external threads share one extra slot), so
+ * readers on different xstreams never touch the same line. A writer pays
+ * for it: it raises the writer flag and waits for every slot to drain.
+ *
+ * A reader increments its slot, then checks the writer flag; a writer sets
+ * the flag, then checks the slots. Both sides use sequentially consistent
+ * operations, so at least one of them sees the other: either the reader
+ * backs off, or the writer waits for it. Readers that back off park on a
+ * condition variable until the writer is done, and new readers back off
+ * too, so a stream of readers cannot starve writers.
+ *
+ * A ULT can move to another xstream while it holds the lock (if it yields
+ * and its pool is shared), so brlock_rdlock() returns the slot it used and
+ * brlock_rdunlock() takes it back.
+ */
+
+#ifndef BRLOCK_H
+#define BRLOCK_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+typedef struct {
+    _Alignas(64) _Atomic int readers;
+} brlock_slot_t;
+
+typedef struct {
+    int num_slots;             /* xstream slots, plus one for others */
+    brlock_slot_t *slots;
+    _Alignas(64) _Atomic int writer;
+    ABT_mutex_memory writer_mutex_mem;  /* serializes writers */
+    ABT_mutex_memory park_mutex_mem;
+    ABT_cond_memory writer_done_mem;
+} brlock_t;
+
+/* num_xstreams: ranks below it get a slot of their own */
+static inline int brlock_init(brlock_t *l, int num_xstreams)
+{
+    if (num_xstreams < 1)
+        return ABT_ERR_INV_ARG;
+    l->num_slots = num_xstreams;
+    l->slots = aligned_alloc(64, sizeof(brlock_slot_t) * (num_xstreams + 1));
+    if (!l->slots)
+        return ABT_ERR_MEM;
+    for (int i = 0; i <= num_xstreams; i++)
+        atomic_init(&l->slots[i].readers, 0);
+    atomic_init(&l->writer, 0);
+    /* Equivalent to ABT_MUTEX_INITIALIZER / ABT_COND_INITIALIZER */
+    memset(&l->writer_mutex_mem, 0, sizeof(l->writer_mutex_mem));
+    memset(&l->park_mutex_mem, 0, sizeof(l->park_mutex_mem));
+    memset(&l->writer_done_mem, 0, sizeof(l->writer_done_mem));
+    return ABT_SUCCESS;
+}
+
+static inline void brlock_destroy(brlock_t *l)
+{
+    free(l->slots);
+    l->slots = NULL;
+}
+
+/* Lets a reader that holds a slot run, if it shares our xstream */
+static inline void brlock_yield(void)
+{
+    ABT_unit_type type;
+    if (ABT_self_get_type(&type) == ABT_SUCCESS &&
+        type == ABT_UNIT_TYPE_THREAD)
+        ABT_thread_yield();
+    else
+        sched_yield();
+}
+
+/* Returns the slot to pass to brlock_rdunlock() */
+static inline int brlock_rdlock(brlock_t *l)
+{
+    int rank, slot;
+    if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS)
+        slot = l->num_slots;                /* external thread */
+    else
+        slot = rank % l->num_slots;
+
+    while (1) {
+        atomic_fetch_add(&l->slots[slot].readers, 1);
+        if (atomic_load(&l->writer) == 0)
+            return slot;
+
+        /* A writer is in: back off and sleep until it is done */
+        atomic_fetch_sub(&l->slots[slot].readers, 1);
+        ABT_mutex park_mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&l->park_mutex_mem);
+        ABT_mutex_lock(park_mutex);
+        while (atomic_load(&l->writer) != 0)
+            ABT_cond_wait(ABT_COND_MEMORY_GET_HANDLE(&l->writer_done_mem),
+                          park_mutex);
+        ABT_mutex_unlock(park_mutex);
+    }
+}
+
+static inline void brlock_rdunlock(brlock_t *l, int slot)
+{
+    atomic_fetch_sub_explicit(&l->slots[slot].readers, 1,
+                              memory_order_release);
+}
+
+static inline void brlock_wrlock(brlock_t *l)
+{
+    ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&l->writer_mutex_mem));
+    atomic_store(&l->writer, 1);
+    for (int i = 0; i <= l->num_slots; i++) {
+        while (atomic_load(&l->slots[i].readers) != 0)
+            brlock_yield();
+    }
+}
+
+static inline void brlock_wrunlock(brlock_t *l)
+{
+    ABT_mutex park_mutex = ABT_MUTEX_MEMORY_GET_HANDLE(&l->park_mutex_mem);
+
+    atomic_store(&l->writer, 0);
+    /* Readers check the flag under park_mutex before they wait */
+    ABT_mutex_lock(park_mutex);
+    ABT_cond_broadcast(ABT_COND_MEMORY_GET_HANDLE(&l->writer_done_mem));
+    ABT_mutex_unlock(park_mutex);
+    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&l->writer_mutex_mem));
+}
+
+#endif /* BRLOCK_H */
@@ -0,0 +1,203 @@
+/*
+ * Eventual wakeup benchmark: set-to-resume latency with many waiters
+ *
+ * w waiter ULTs are spread round-robin over x xstreams (one pool each) and
+ * wait on an eventual holding a value of s bytes, as ULTs waiting for a
+ * configuration reload would. Once they are all parked, the primary
+ * xstream sets the eventual; every waiter records when it resumed.
+ *   eventual: ABT_eventual, whose set copies the value and wakes the
+ *             waiters one by one from the setter
+ *   bcast:    bcast_eventual.h, which passes the value by pointer and
+ *             wakes the waiters of each xstream from that xstream
+ * Reported: how long the set call took, and the p50/p99/max of the time
+ * from the set to the resume of each waiter (max: all waiters resumed).
+ *
+ * Usage: 06_abt_eventual_wakeup [-x xstreams] [-w waiters,...]
+ *                               [-s value_size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <abt.h>
+#include "bcast_eventual.h"
+
+#define NUM_XSTREAMS 4
+#define WAITERS "1,10,100,1000,10000,100000"
+#define VALUE_SIZE 4096
+#define MAX_VALUES 16
+
+typedef struct {
+    int use_bcast;
+    ABT_eventual eventual;
+    bcast_eventual_t bcast;
+    _Atomic int num_parked;    /* waiters about to wait */
+    double *resume_time;       /* indexed by waiter */
+} bench_t;
+
+typedef struct {
+    bench_t *bench;
+    int index;
+} waiter_arg_t;
+
+void waiter(void *arg)
+{
+    waiter_arg_t *w = (waiter_arg_t *)arg;
+    bench_t *b = w->bench;
+    char *value;
+
+    atomic_fetch_add(&b->num_parked, 1);
+    if (b->use_bcast)
+        value = bcast_eventual_wait(&b->bcast);
+    else
+        ABT_eventual_wait(b->eventual, (void **)&value);
+    b->resume_time[w->index] = ABT_get_wtime();
+    if (value[0] != 1)
+        fprintf(stderr, "Error: waiter %d read a wrong value\n", w->index);
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Runs one configuration and prints its line */
+void run(int use_bcast, int num_xstreams, int num_waiters, int value_size,
+         char *value, double *resume_time)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_waiters);
+    waiter_arg_t *args = malloc(sizeof(waiter_arg_t) * num_waiters);
+    bench_t bench;
+
+    ABT_init(0, NULL);
+
+    memset(&bench, 0, sizeof(bench));
+    bench.use_bcast = use_bcast;
+    bench.resume_time = resume_time;
+    atomic_init(&bench.num_parked, 0);
+    if (use_bcast)
+        bcast_eventual_init(&bench.bcast, num_xstreams + 1);
+    else
+        ABT_eventual_create(value_size, &bench.eventual);
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[i]);
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pools[i],
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_waiters; i++) {
+        args[i].bench = &bench;
+        args[i].index = i;
+        ABT_thread_create(pools[i % num_xstreams], waiter, &args[i],
+                          ABT_THREAD_ATTR_NULL, &threads[i]);
+    }
+
+    /* Let the last waiters get from the counter into the wait */
+    while (atomic_load(&bench.num_parked) < num_waiters)
+        usleep(1000);
+    usleep(10000);
+
+    double start_time = ABT_get_wtime();
+    if (use_bcast)
+        bcast_eventual_set(&bench.bcast, value);
+    else
+        ABT_eventual_set(bench.eventual, value, value_size);
+    double set_time = ABT_get_wtime() - start_time;
+
+    for (int i = 0; i < num_waiters; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    if (use_bcast)
+        bcast_eventual_destroy(&bench.bcast);
+    else
+        ABT_eventual_free(&bench.eventual);
+    ABT_finalize();
+
+    for (int i = 0; i < num_waiters; i++)
+        resume_time[i] -= start_time;
+    qsort(resume_time, num_waiters, sizeof(double), compare_double);
+    printf("%-8d %-9s %10.1f %10.1f %10.1f %10.1f\n", num_waiters,
+           use_bcast ? "bcast" : "eventual", set_time * 1e6,
+           resume_time[num_waiters / 2] * 1e6,
+           resume_time[(int)(num_waiters * 0.99)] * 1e6,
+           resume_time[num_waiters - 1] * 1e6);
+
+    free(args);
+    free(threads);
+    free(pools);
+    free(xstreams);
+}
+
+int parse_list(const char *arg, int *values)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < 1)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int waiters[MAX_VALUES], num_w = parse_list(WAITERS, waiters);
+    int value_size = VALUE_SIZE;
+    int max_waiters = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:w:s:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'w': num_w = parse_list(optarg, waiters); break;
+            case 's': value_size = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-w waiters,...] "
+                        "[-s value_size]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || !num_w || value_size < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+    for (int i = 0; i < num_w; i++) {
+        if (waiters[i] > max_waiters)
+            max_waiters = waiters[i];
+    }
+
+    char *value = malloc(value_size);
+    double *resume_time = malloc(sizeof(double) * max_waiters);
+    memset(value, 1, value_size);
+
+    printf("=== Eventual Wakeup Benchmark ===\n");
+    printf("%d xstreams, value of %d bytes\n\n", num_xstreams, value_size);
+    printf("%-8s %-9s %10s %10s %10s %10s\n", "waiters", "version",
+           "set(us)", "p50(us)", "p99(us)", "max(us)");
+
+    for (int i = 0; i < num_w; i++) {
+        run(0, num_xstreams, waiters[i], value_size, value, resume_time);
+        run(1, num_xstreams, waiters[i], value_size, value, resume_time);
+    }
+
+    printf("\nLatencies are measured from the start of the set call\n");
+
+    free(resume_time);
+    free(value);
+    return 0;
+}
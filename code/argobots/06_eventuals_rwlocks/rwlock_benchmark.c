@@ -0,0 +1,288 @@
+/*
+ * Reader-writer lock benchmark: ABT_rwlock vs big reader lock vs seqlock
+ *
+ * One ULT per xstream runs n operations on a small shared record, as the
+ * readers and writers of rwlock_example.c do on shared_data_t; each
+ * operation is a write with probability w% and a read otherwise. A read
+ * copies the record and checks that its fields are equal, so a torn copy
+ * would be reported. One read out of SAMPLE_EVERY is timed, for the read
+ * latency percentiles. The seqlock also reports how many read attempts
+ * had to be retried because a writer overlapped them.
+ *   rwlock:  ABT_rwlock
+ *   brlock:  brlock.h, one reader count per xstream
+ *   seqlock: seqlock.h, readers never write to shared memory
+ * Every combination of xstream count and write percentage is run with
+ * each lock; the speedup is relative to the first xstream count.
+ *
+ * Usage: 06_abt_rwlock_benchmark [-x xstreams,...] [-n ops] [-w write%,...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+#include "brlock.h"
+#include "seqlock.h"
+
+#define XSTREAMS "1,2,4,8"
+#define NUM_OPS 1000000
+#define WRITE_PERCENTS "1,10"
+#define MAX_VALUES 16
+#define RECORD_FIELDS 8
+#define SAMPLE_EVERY 16
+
+enum { LOCK_RWLOCK, LOCK_BRLOCK, LOCK_SEQLOCK, NUM_LOCKS };
+static const char *lock_names[NUM_LOCKS] = {"rwlock", "brlock", "seqlock"};
+
+typedef struct {
+    long fields[RECORD_FIELDS];
+} record_t;
+
+typedef struct {
+    int lock;
+    int num_ops;
+    int write_percent;
+    ABT_rwlock rwlock;
+    brlock_t brlock;
+    seqlock_t seqlock;
+    record_t record;
+} bench_t;
+
+typedef struct {
+    _Alignas(64) bench_t *bench;  /* one cache line per ULT */
+    unsigned int seed;
+    long reads;
+    long retries;
+    long torn_reads;
+    int num_samples;
+    double *samples;           /* latency of every SAMPLE_EVERY-th read */
+} worker_arg_t;
+
+void read_record(bench_t *b, worker_arg_t *w)
+{
+    record_t copy;
+
+    if (b->lock == LOCK_SEQLOCK) {
+        unsigned seq = seqlock_read_begin(&b->seqlock);
+        copy = b->record;
+        while (seqlock_read_retry(&b->seqlock, seq)) {
+            w->retries++;
+            seq = seqlock_read_begin(&b->seqlock);
+            copy = b->record;
+        }
+    } else if (b->lock == LOCK_BRLOCK) {
+        int slot = brlock_rdlock(&b->brlock);
+        copy = b->record;
+        brlock_rdunlock(&b->brlock, slot);
+    } else {
+        ABT_rwlock_rdlock(b->rwlock);
+        copy = b->record;
+        ABT_rwlock_unlock(b->rwlock);
+    }
+
+    for (int i = 1; i < RECORD_FIELDS; i++) {
+        if (copy.fields[i] != copy.fields[0]) {
+            w->torn_reads++;
+            break;
+        }
+    }
+    w->reads++;
+}
+
+void write_record(bench_t *b)
+{
+    if (b->lock == LOCK_SEQLOCK)
+        seqlock_write_lock(&b->seqlock);
+    else if (b->lock == LOCK_BRLOCK)
+        brlock_wrlock(&b->brlock);
+    else
+        ABT_rwlock_wrlock(b->rwlock);
+    for (int i = 0; i < RECORD_FIELDS; i++)
+        b->record.fields[i]++;
+    if (b->lock == LOCK_SEQLOCK)
+        seqlock_write_unlock(&b->seqlock);
+    else if (b->lock == LOCK_BRLOCK)
+        brlock_wrunlock(&b->brlock);
+    else
+        ABT_rwlock_unlock(b->rwlock);
+}
+
+void worker(void *arg)
+{
+    worker_arg_t *w = (worker_arg_t *)arg;
+    bench_t *b = w->bench;
+
+    for (int i = 0; i < b->num_ops; i++) {
+        /* xorshift: cheap and private to the ULT */
+        w->seed ^= w->seed << 13;
+        w->seed ^= w->seed >> 17;
+        w->seed ^= w->seed << 5;
+
+        if ((int)(w->seed % 100) < b->write_percent) {
+            write_record(b);
+        } else if (w->reads % SAMPLE_EVERY == 0) {
+            double start = ABT_get_wtime();
+            read_record(b, w);
+            w->samples[w->num_samples++] = ABT_get_wtime() - start;
+        } else {
+            read_record(b, w);
+        }
+    }
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Runs one configuration and prints its line; returns the reads per second */
+double run(int lock, int num_xstreams, int num_ops, int write_percent,
+           double base)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_xstreams);
+    worker_arg_t *args = aligned_alloc(64, sizeof(worker_arg_t) *
+                                               num_xstreams);
+    int max_samples = num_ops / SAMPLE_EVERY + 1;
+    double *samples = malloc(sizeof(double) * max_samples * num_xstreams);
+    bench_t bench;
+
+    ABT_init(0, NULL);
+
+    memset(&bench, 0, sizeof(bench));
+    bench.lock = lock;
+    bench.num_ops = num_ops;
+    bench.write_percent = write_percent;
+    ABT_rwlock_create(&bench.rwlock);
+    /* Ranks 0..num_xstreams: the primary xstream only waits */
+    brlock_init(&bench.brlock, num_xstreams + 1);
+    seqlock_init(&bench.seqlock);
+
+    /* One ULT per xstream, each on a private pool */
+    for (int i = 0; i < num_xstreams; i++) {
+        worker_arg_t *w = &args[i];
+        memset(w, 0, sizeof(worker_arg_t));
+        w->bench = &bench;
+        w->seed = 2463534242u + i;
+        w->samples = &samples[i * max_samples];
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPSC, ABT_TRUE,
+                              &pools[i]);
+        ABT_thread_create(pools[i], worker, w, ABT_THREAD_ATTR_NULL,
+                          &threads[i]);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pools[i],
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    long reads = 0, retries = 0, torn_reads = 0;
+    int num_samples = 0;
+    for (int i = 0; i < num_xstreams; i++) {
+        reads += args[i].reads;
+        retries += args[i].retries;
+        torn_reads += args[i].torn_reads;
+        /* Gather the samples at the front of the array */
+        memmove(&samples[num_samples], args[i].samples,
+                sizeof(double) * args[i].num_samples);
+        num_samples += args[i].num_samples;
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    brlock_destroy(&bench.brlock);
+    ABT_rwlock_free(&bench.rwlock);
+    ABT_finalize();
+
+    double rate = reads / elapsed;
+    if (base == 0.0)
+        base = rate;
+    qsort(samples, num_samples, sizeof(double), compare_double);
+    printf("%-7d %-9d %-8s %14.0f %8.2fx", write_percent, num_xstreams,
+           lock_names[lock], rate, rate / base);
+    if (num_samples > 0) {
+        printf(" %8.0f %8.0f", samples[num_samples / 2] * 1e9,
+               samples[(int)(num_samples * 0.99)] * 1e9);
+    } else {
+        printf(" %8s %8s", "-", "-");
+    }
+    if (lock == LOCK_SEQLOCK)
+        printf(" %8.3f", reads ? (double)retries / reads : 0.0);
+    else
+        printf(" %8s", "-");
+    printf("%s\n", torn_reads ? "  TORN READS" : "");
+
+    free(samples);
+    free(args);
+    free(threads);
+    free(pools);
+    free(xstreams);
+    return rate;
+}
+
+int parse_list(const char *arg, int *values, int min, int max)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < min || values[num] > max)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int xstreams[MAX_VALUES], num_x = parse_list(XSTREAMS, xstreams, 1, 1024);
+    int writes[MAX_VALUES], num_w = parse_list(WRITE_PERCENTS, writes, 0, 100);
+    int num_ops = NUM_OPS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:w:")) != -1) {
+        switch (opt) {
+            case 'x': num_x = parse_list(optarg, xstreams, 1, 1024); break;
+            case 'n': num_ops = atoi(optarg); break;
+            case 'w': num_w = parse_list(optarg, writes, 0, 100); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams,...] [-n ops] "
+                        "[-w write%%,...]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!num_x || !num_w || num_ops < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Reader-Writer Lock Benchmark ===\n");
+    printf("%d operations per xstream, one read in %d timed\n\n", num_ops,
+           SAMPLE_EVERY);
+    printf("%-7s %-9s %-8s %14s %9s %8s %8s %8s\n", "write%", "xstreams",
+           "lock", "reads/s", "speedup", "p50(ns)", "p99(ns)", "retries");
+
+    for (int w = 0; w < num_w; w++) {
+        for (int lock = 0; lock < NUM_LOCKS; lock++) {
+            double base = 0.0;
+            for (int x = 0; x < num_x; x++) {
+                double rate = run(lock, xstreams[x], num_ops, writes[w], base);
+                if (x == 0)
+                    base = rate;
+            }
+        }
+    }
+
+    printf("\nLatencies include two ABT_get_wtime() calls\n");
+    printf("Retries: seqlock read attempts a writer overlapped, per read\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Sequence lock: optimistic, lock-free reads of small shared records
+ *
+ * The sequence number is even when the record is stable and odd while a
+ * writer is updating it. A reader never writes to shared memory: it reads
+ * the sequence number, copies the record, and reads the sequence number
+ * again; if it changed (or was odd), a writer overlapped and the reader
+ * retries. Readers therefore never slow each other down or delay writers.
+ *
+ *     unsigned seq;
+ *     do {
+ *         seq = seqlock_read_begin(&lock);
+ *         copy = shared;             // copy only: do not follow pointers
+ *     } while (seqlock_read_retry(&lock, seq));
+ *
+ * Writers are serialized by an ABT_mutex, so a writer ULT that waits for
+ * another one blocks without blocking its xstream. A reader that finds a
+ * write in progress spins briefly and then yields, in case the writer is a
+ * ULT waiting to run on the same xstream.
+ *
+ * Suited to small records (a few cache lines) that are read far more
+ * often than written: a reader copies the whole record on every attempt.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <string.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define SEQLOCK_SPINS 100      /* pause loops before a waiting reader yields */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define seqlock_pause() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define seqlock_pause() __asm__ __volatile__("yield")
+#else
+#define seqlock_pause() ((void)0)
+#endif
+
+typedef struct {
+    _Atomic unsigned seq;
+    ABT_mutex_memory writer_mutex_mem;
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *l)
+{
+    atomic_init(&l->seq, 0);
+    /* Equivalent to ABT_MUTEX_INITIALIZER */
+    memset(&l->writer_mutex_mem, 0, sizeof(l->writer_mutex_mem));
+}
+
+static inline void seqlock_yield(void)
+{
+    ABT_unit_type type;
+    if (ABT_self_get_type(&type) == ABT_SUCCESS &&
+        type == ABT_UNIT_TYPE_THREAD)
+        ABT_thread_yield();
+    else
+        sched_yield();
+}
+
+/* Waits until no write is in progress; returns the sequence number */
+static inline unsigned seqlock_read_begin(seqlock_t *l)
+{
+    int spins = 0;
+    unsigned seq;
+    while ((seq = atomic_load_explicit(&l->seq, memory_order_acquire)) & 1) {
+        if (++spins < SEQLOCK_SPINS) {
+            seqlock_pause();
+        } else {
+            seqlock_yield();
+            spins = 0;
+        }
+    }
+    return seq;
+}
+
+/* Nonzero if a writer overlapped the read started with seq */
+static inline int seqlock_read_retry(seqlock_t *l, unsigned seq)
+{
+    /* Keeps the reads of the record before the second load */
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&l->seq, memory_order_relaxed) != seq;
+}
+
+static inline void seqlock_write_lock(seqlock_t *l)
+{
+    ABT_mutex_lock(ABT_MUTEX_MEMORY_GET_HANDLE(&l->writer_mutex_mem));
+    /* Odd: readers that start now wait, readers in progress retry */
+    atomic_store_explicit(&l->seq,
+                          atomic_load_explicit(&l->seq, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    /* Keeps the writes to the record after the store */
+    atomic_thread_fence(memory_order_release);
+}
+
+static inline void seqlock_write_unlock(seqlock_t *l)
+{
+    /* Even again: publishes the writes to the record */
+    atomic_store_explicit(&l->seq,
+                          atomic_load_explicit(&l->seq, memory_order_relaxed) + 1,
+                          memory_order_release);
+    ABT_mutex_unlock(ABT_MUTEX_MEMORY_GET_HANDLE(&l->writer_mutex_mem));
+}
+
+#endif /* SEQLOCK_H */
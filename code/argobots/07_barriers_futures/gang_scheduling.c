@@ -0,0 +1,403 @@
+/*
+ * Gang scheduling for barrier-synchronized ULT groups
+ * Measures barrier wait time with and without gang scheduling under
+ * background load
+ *
+ * A gang is a group of ULTs that meet at a barrier every iteration, here
+ * possibly more ULTs than execution streams. With a FIFO scheduler, a gang
+ * member woken up by the barrier is queued behind the background ULTs of
+ * its execution stream, and the whole gang waits for the last one to get
+ * its turn.
+ *
+ * Gang members tag themselves with an ABT_key (gang_join()). The gang
+ * schedulers of all execution streams share one gang pool and one gang_t:
+ *   - a scheduler that pops a tagged ULT from its main pool associates it
+ *     with the gang pool, so every later wakeup of the member goes there,
+ *     where any execution stream can pick it up
+ *   - members meet at gang_barrier_wait(); the last one to arrive opens a
+ *     round: the other size - 1 members are about to be woken up
+ *   - while a round has members that were not dispatched yet, no gang
+ *     scheduler pops background work: every execution stream that becomes
+ *     free takes the next member, until the whole gang has been dispatched
+ * So a round of the gang runs on all the execution streams together, in as
+ * many waves as it has members per execution stream.
+ *
+ * Usage: 07_abt_gang_scheduling [-x xstreams] [-g gang_sizes,...]
+ *                               [-i iterations] [-w work_us]
+ *                               [-b background_ults_per_xstream]
+ *                               [-s background_slice_us]
+ *   the default gang sizes are x and 2x
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+#define NUM_XSTREAMS 4
+#define ITERATIONS 200
+#define WORK_US 50             /* gang member work per iteration */
+#define BACKGROUND_ULTS 2      /* per xstream */
+#define SLICE_US 100           /* background work between two yields */
+#define EVENT_FREQ 64
+#define MAX_VALUES 16
+
+ABT_key gang_key;              /* value: the gang_t of the ULT, or NULL */
+
+/* Shared by the members and by the gang schedulers of all execution streams */
+typedef struct {
+    int size;                  /* number of members */
+    ABT_barrier barrier;
+    ABT_pool pool;             /* where woken members wait for a stream */
+    _Atomic int arrived;       /* members at the barrier in this round */
+    _Atomic int pending;       /* woken members not dispatched yet */
+} gang_t;
+
+typedef struct {
+    int event_freq;
+    gang_t *gang;
+    ABT_pool pools[2];         /* pools[0]: main pool, pools[1]: gang pool */
+} sched_data_t;
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_gang = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_PTR
+};
+
+int gang_init(gang_t *gang, int size)
+{
+    gang->size = size;
+    gang->pool = ABT_POOL_NULL;
+    atomic_init(&gang->arrived, 0);
+    atomic_init(&gang->pending, 0);
+    return ABT_barrier_create(size, &gang->barrier);
+}
+
+void gang_destroy(gang_t *gang)
+{
+    ABT_barrier_free(&gang->barrier);
+}
+
+/*
+ * Replaces ABT_barrier_wait() for gang members. The last member to arrive
+ * publishes the round before it enters the barrier, so the schedulers hold
+ * back background work before the others are woken up.
+ */
+void gang_barrier_wait(gang_t *gang)
+{
+    if (atomic_fetch_add(&gang->arrived, 1) == gang->size - 1) {
+        /* The others arrived: they all block, or are about to */
+        atomic_store(&gang->arrived, 0);
+        atomic_store(&gang->pending, gang->size - 1);
+    }
+    ABT_barrier_wait(gang->barrier);
+}
+
+/* A member of the round left the gang pool */
+static void gang_dispatched(gang_t *gang)
+{
+    int pending = atomic_load(&gang->pending);
+    while (pending > 0 &&
+           !atomic_compare_exchange_weak(&gang->pending, &pending, pending - 1))
+        ;
+}
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 2, &data->event_freq, &data->gang);
+    ABT_sched_get_pools(sched, 2, 0, data->pools);
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int work_count = 0;
+
+    ABT_sched_get_data(sched, (void **)&data);
+
+    while (1) {
+        ABT_thread thread;
+
+        /* Gang members first, whichever stream they last ran on */
+        ABT_pool_pop_thread(data->pools[1], &thread);
+        if (thread != ABT_THREAD_NULL) {
+            gang_dispatched(data->gang);
+        } else if (atomic_load(&data->gang->pending) == 0) {
+            /* No member of the round is waiting for a stream */
+            ABT_pool_pop_thread(data->pools[0], &thread);
+            if (thread != ABT_THREAD_NULL) {
+                void *gang;
+                ABT_thread_get_specific(thread, gang_key, &gang);
+                /* A gang member: from now on, its wakeups go to the
+                 * shared gang pool */
+                if (gang == data->gang)
+                    ABT_thread_set_associated_pool(thread, data->pools[1]);
+            }
+        }
+
+        if (thread != ABT_THREAD_NULL)
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/* main_pool is private to the stream; gang->pool is shared by all of them */
+int gang_sched_create(ABT_pool main_pool, gang_t *gang, ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_pool pools[2] = {main_pool, gang->pool};
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_gang, gang,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, 2, pools, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/*
+ * Called by a gang member when it starts: tag it, then yield so that the
+ * scheduler sees the tag when it pops the member again
+ */
+void gang_join(gang_t *gang)
+{
+    ABT_self_set_specific(gang_key, gang);
+    ABT_self_yield();
+}
+
+/* ---- Benchmark ---- */
+
+typedef struct {
+    int iterations;
+    gang_t *gang;
+    double *waits;             /* barrier wait time of each iteration */
+} member_arg_t;
+
+double work_time, slice_time;
+volatile int background_stop;
+
+void spin(double seconds)
+{
+    double start = ABT_get_wtime();
+    while (ABT_get_wtime() - start < seconds)
+        ;
+}
+
+void member_func(void *arg)
+{
+    member_arg_t *member = (member_arg_t *)arg;
+
+    gang_join(member->gang);
+    for (int i = 0; i < member->iterations; i++) {
+        spin(work_time);
+        double start = ABT_get_wtime();
+        gang_barrier_wait(member->gang);
+        member->waits[i] = ABT_get_wtime() - start;
+    }
+}
+
+void background_func(void *arg)
+{
+    while (!background_stop) {
+        spin(slice_time);
+        ABT_self_yield();
+    }
+}
+
+int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void run_mode(const char *name, int use_gang, int num_xstreams, int gang_size,
+              int iterations, int num_background)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_thread *members = malloc(sizeof(ABT_thread) * gang_size);
+    member_arg_t *args = malloc(sizeof(member_arg_t) * gang_size);
+    int total_background = num_xstreams * num_background;
+    ABT_thread *background = malloc(sizeof(ABT_thread) * (total_background + 1));
+    int num_waits = gang_size * iterations;
+    double *waits = malloc(sizeof(double) * num_waits);
+    gang_t gang;
+
+    ABT_init(0, NULL);
+    ABT_key_create(NULL, &gang_key);
+    gang_init(&gang, gang_size);
+    if (use_gang) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &gang.pool);
+    }
+
+    /* The primary execution stream keeps its scheduler and only waits */
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_sched sched;
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[i]);
+        if (use_gang) {
+            gang_sched_create(pools[i], &gang, &sched);
+        } else {
+            ABT_sched_create_basic(ABT_SCHED_BASIC, 1, &pools[i],
+                                   ABT_SCHED_CONFIG_NULL, &sched);
+        }
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+
+    background_stop = 0;
+    for (int i = 0; i < total_background; i++) {
+        ABT_thread_create(pools[i % num_xstreams], background_func, NULL,
+                          ABT_THREAD_ATTR_NULL, &background[i]);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < gang_size; i++) {
+        args[i].iterations = iterations;
+        args[i].gang = &gang;
+        args[i].waits = &waits[i * iterations];
+        ABT_thread_create(pools[i % num_xstreams], member_func, &args[i],
+                          ABT_THREAD_ATTR_NULL, &members[i]);
+    }
+    for (int i = 0; i < gang_size; i++) {
+        ABT_thread_free(&members[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    background_stop = 1;
+    for (int i = 0; i < total_background; i++) {
+        ABT_thread_free(&background[i]);
+    }
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    gang_destroy(&gang);
+    ABT_key_free(&gang_key);
+    ABT_finalize();
+
+    double sum = 0.0;
+    for (int i = 0; i < num_waits; i++)
+        sum += waits[i];
+    qsort(waits, num_waits, sizeof(double), compare_double);
+    printf("%-6d %-8s %10.4f %12.1f %10.1f %10.1f %10.1f\n", gang_size, name,
+           elapsed, elapsed / iterations * 1e6, sum / num_waits * 1e6,
+           waits[(int)(num_waits * 0.99)] * 1e6, waits[num_waits - 1] * 1e6);
+
+    free(waits);
+    free(background);
+    free(args);
+    free(members);
+    free(pools);
+    free(xstreams);
+}
+
+int parse_list(const char *arg, int *values)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < 1)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    int gang_sizes[MAX_VALUES], num_g = -1;
+    int iterations = ITERATIONS;
+    int work_us = WORK_US;
+    int num_background = BACKGROUND_ULTS;
+    int slice_us = SLICE_US;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:g:i:w:b:s:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'g': num_g = parse_list(optarg, gang_sizes); break;
+            case 'i': iterations = atoi(optarg); break;
+            case 'w': work_us = atoi(optarg); break;
+            case 'b': num_background = atoi(optarg); break;
+            case 's': slice_us = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] [-g gang_sizes,...] "
+                        "[-i iterations] [-w work_us] "
+                        "[-b background_ults_per_xstream] "
+                        "[-s background_slice_us]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (num_xstreams < 1 || !num_g || iterations < 1 || work_us < 0 ||
+        num_background < 0 || slice_us < 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+    if (num_g < 0) {
+        /* One member per stream, then more members than streams */
+        gang_sizes[0] = num_xstreams;
+        gang_sizes[1] = 2 * num_xstreams;
+        num_g = 2;
+    }
+    work_time = work_us * 1e-6;
+    slice_time = slice_us * 1e-6;
+
+    printf("=== Gang Scheduling ===\n");
+    printf("%d xstreams, %d iterations of %d us; "
+           "%d background ULTs per xstream (%d us slices)\n\n",
+           num_xstreams, iterations, work_us, num_background, slice_us);
+    printf("%-6s %-8s %10s %12s %10s %10s %10s\n", "gang", "mode", "time(s)",
+           "iter(us)", "wait(us)", "p99(us)", "max(us)");
+
+    for (int g = 0; g < num_g; g++) {
+        run_mode("fifo", 0, num_xstreams, gang_sizes[g], iterations,
+                 num_background);
+        run_mode("gang", 1, num_xstreams, gang_sizes[g], iterations,
+                 num_background);
+    }
+
+    printf("\nwait: time a gang member spends in the barrier\n");
+    return 0;
+}
@@ -1,6 +1,8 @@
 /*
  * Stencil computation with barriers
  * Demonstrates bulk-synchronous parallel pattern
+ * Double-buffered: each iteration reads one buffer and writes the other,
+ * so a single barrier per iteration is enough
  */
 
 #include <stdio.h>
@@ -14,7 +16,7 @@
 typedef struct {
     int thread_id;
     int num_threads;
-    double *array;
+    double *array;             /* input of the first iteration */
     double *temp;
     ABT_barrier barrier;
 } work_arg_t;
@@ -27,25 +29,25 @@ void stencil_worker(void *arg)
     int chunk_size = ARRAY_SIZE / num;
     int start = id * chunk_size;
     int end = (id == num - 1) ? ARRAY_SIZE : start + chunk_size;
+    double *src = work->array;
+    double *dst = work->temp;
 
     for (int iter = 0; iter < NUM_ITERATIONS; iter++) {
-        /* Compute stencil: temp[i] = average of array[i-1], array[i], array[i+1] */
+        /* Compute stencil: dst[i] = average of src[i-1], src[i], src[i+1] */
         for (int i = start; i < end; i++) {
             int left = (i == 0) ? 0 : i - 1;
             int right = (i == ARRAY_SIZE - 1) ? ARRAY_SIZE - 1 : i + 1;
-            work->temp[i] = (work->array[left] + work->array[i] + work->array[right]) / 3.0;
+            dst[i] = (src[left] + src[i] + src[right]) / 3.0;
         }
 
         /* Barrier: Wait for all threads to finish computation */
         ABT_barrier_wait(work->barrier);
 
-        /* Copy temp back to array */
-        for (int i = start; i < end; i++) {
-            work->array[i] = work->temp[i];
-        }
-
-        /* Barrier: Wait for all threads to finish copying */
-        ABT_barrier_wait(work->barrier);
+        /* Swap the buffers: the next iteration reads what this one wrote,
+         * and overwrites what everyone finished reading before the barrier */
+        double *swap = src;
+        src = dst;
+        dst = swap;
 
         if (id == 0) {
             printf("Iteration %d completed\n", iter);
@@ -103,9 +105,11 @@ int main(int argc, char **argv)
         ABT_thread_free(&threads[i]);
     }
 
+    /* The last iteration wrote temp if the number of iterations is odd */
+    double *result = (NUM_ITERATIONS % 2) ? temp : array;
     printf("\nFinal array:\n");
     for (int i = 0; i < ARRAY_SIZE; i++) {
-        printf("%.1f ", array[i]);
+        printf("%.1f ", result[i]);
     }
     printf("\n\n");
 
@@ -0,0 +1,169 @@
+/*
+ * Counter scaling: mutex-protected vs shared atomic vs sharded counter
+ *
+ * One ULT per xstream adds 1 to a counter n times, as request accounting
+ * does for every request it sees:
+ *   mutex:   an int under an ABT_mutex (the pattern of yield_sync.c)
+ *   atomic:  one shared atomic, which still moves its cache line between
+ *            the cores on every increment
+ *   sharded: sharded_counter.h
+ * Each version is run for every xstream count of the -x list; the speedup
+ * is relative to the first xstream count.
+ *
+ * Usage: 09_abt_counter_scaling [-x xstreams,...] [-n increments]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <abt.h>
+#include "sharded_counter.h"
+
+#define XSTREAMS "1,2,4,8"
+#define NUM_INCREMENTS 1000000
+#define MAX_VALUES 16
+
+enum { MODE_MUTEX, MODE_ATOMIC, MODE_SHARDED, NUM_MODES };
+static const char *mode_names[NUM_MODES] = {"mutex", "atomic", "sharded"};
+
+typedef struct {
+    int mode;
+    int num_increments;
+    long counter;              /* MODE_MUTEX */
+    ABT_mutex mutex;
+    _Alignas(64) _Atomic long atomic_counter;
+    sharded_counter_t sharded;
+} bench_t;
+
+void worker(void *arg)
+{
+    bench_t *b = (bench_t *)arg;
+
+    for (int i = 0; i < b->num_increments; i++) {
+        if (b->mode == MODE_MUTEX) {
+            ABT_mutex_lock(b->mutex);
+            b->counter++;
+            ABT_mutex_unlock(b->mutex);
+        } else if (b->mode == MODE_ATOMIC) {
+            atomic_fetch_add_explicit(&b->atomic_counter, 1,
+                                      memory_order_relaxed);
+        } else {
+            sharded_counter_inc(&b->sharded);
+        }
+    }
+}
+
+/* Returns the increments per second */
+double run(int mode, int num_xstreams, int num_increments)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    ABT_pool *pools = malloc(sizeof(ABT_pool) * num_xstreams);
+    ABT_thread *threads = malloc(sizeof(ABT_thread) * num_xstreams);
+    bench_t *bench = aligned_alloc(64, sizeof(bench_t));
+    long total = (long)num_increments * num_xstreams;
+
+    ABT_init(0, NULL);
+
+    memset(bench, 0, sizeof(bench_t));
+    bench->mode = mode;
+    bench->num_increments = num_increments;
+    atomic_init(&bench->atomic_counter, 0);
+    ABT_mutex_create(&bench->mutex);
+    /* Ranks 0..num_xstreams: the primary xstream only waits */
+    sharded_counter_init(&bench->sharded, num_xstreams + 1);
+
+    /* One ULT per xstream, each on a private pool */
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPSC, ABT_TRUE,
+                              &pools[i]);
+        ABT_thread_create(pools[i], worker, bench, ABT_THREAD_ATTR_NULL,
+                          &threads[i]);
+    }
+
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_create_basic(ABT_SCHED_BASIC, 1, &pools[i],
+                                 ABT_SCHED_CONFIG_NULL, &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_thread_free(&threads[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+
+    long result = mode == MODE_MUTEX    ? bench->counter
+                  : mode == MODE_ATOMIC ? atomic_load(&bench->atomic_counter)
+                                        : sharded_counter_read(&bench->sharded);
+    if (result != total)
+        fprintf(stderr, "Error: %s counted %ld instead of %ld\n",
+                mode_names[mode], result, total);
+
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    sharded_counter_destroy(&bench->sharded);
+    ABT_mutex_free(&bench->mutex);
+    ABT_finalize();
+
+    free(bench);
+    free(threads);
+    free(pools);
+    free(xstreams);
+    return total / elapsed;
+}
+
+int parse_list(const char *arg, int *values)
+{
+    char list[256];
+    int num = 0;
+    snprintf(list, sizeof(list), "%s", arg);
+    for (char *tok = strtok(list, ","); tok && num < MAX_VALUES;
+         tok = strtok(NULL, ",")) {
+        values[num] = atoi(tok);
+        if (values[num] < 1)
+            return 0;
+        num++;
+    }
+    return num;
+}
+
+int main(int argc, char **argv)
+{
+    int xstreams[MAX_VALUES], num_x = parse_list(XSTREAMS, xstreams);
+    int num_increments = NUM_INCREMENTS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:")) != -1) {
+        switch (opt) {
+            case 'x': num_x = parse_list(optarg, xstreams); break;
+            case 'n': num_increments = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams,...] "
+                        "[-n increments]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (!num_x || num_increments < 1) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+
+    printf("=== Counter Scaling ===\n");
+    printf("%d increments per xstream\n\n", num_increments);
+    printf("%-9s %-8s %14s %9s\n", "xstreams", "counter", "increments/s",
+           "speedup");
+
+    for (int mode = 0; mode < NUM_MODES; mode++) {
+        double base = 0.0;
+        for (int x = 0; x < num_x; x++) {
+            double rate = run(mode, xstreams[x], num_increments);
+            if (x == 0)
+                base = rate;
+            printf("%-9d %-8s %14.0f %8.2fx\n", xstreams[x], mode_names[mode],
+                   rate, rate / base);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Sharded counter: per-xstream slots instead of one shared, locked counter
+ *
+ * Each xstream adds to its own slot, indexed by ABT_xstream_self_rank() and
+ * padded to a cache line, so increments from different xstreams never touch
+ * the same line. Adds are relaxed atomics: they only need to be atomic
+ * because external threads (which have no rank) share one extra slot, and
+ * because xstream ranks beyond the slot count wrap around.
+ *
+ * sharded_counter_read() sums the slots without stopping concurrent adds.
+ * The sum is not a snapshot, but for a counter that only grows it lies
+ * between the totals at the start and at the end of the read, which is
+ * what statistics need; once the adders are done (e.g. after
+ * ABT_thread_free()), it is exact.
+ */
+
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+typedef struct {
+    _Alignas(64) _Atomic long value;
+} sharded_counter_slot_t;
+
+typedef struct {
+    int num_slots;             /* xstream slots, plus one for others */
+    sharded_counter_slot_t *slots;
+} sharded_counter_t;
+
+/* num_xstreams: ranks below it get a slot of their own */
+static inline int sharded_counter_init(sharded_counter_t *c, int num_xstreams)
+{
+    if (num_xstreams < 1)
+        return ABT_ERR_INV_ARG;
+    c->num_slots = num_xstreams;
+    c->slots = aligned_alloc(64, sizeof(sharded_counter_slot_t) *
+                                     (num_xstreams + 1));
+    if (!c->slots)
+        return ABT_ERR_MEM;
+    for (int i = 0; i <= num_xstreams; i++)
+        atomic_init(&c->slots[i].value, 0);
+    return ABT_SUCCESS;
+}
+
+static inline void sharded_counter_destroy(sharded_counter_t *c)
+{
+    free(c->slots);
+    c->slots = NULL;
+}
+
+static inline sharded_counter_slot_t *sharded_counter_slot(sharded_counter_t *c)
+{
+    int rank;
+    if (ABT_xstream_self_rank(&rank) != ABT_SUCCESS)
+        return &c->slots[c->num_slots];     /* external thread */
+    return &c->slots[rank % c->num_slots];
+}
+
+static inline void sharded_counter_add(sharded_counter_t *c, long value)
+{
+    atomic_fetch_add_explicit(&sharded_counter_slot(c)->value, value,
+                              memory_order_relaxed);
+}
+
+static inline void sharded_counter_inc(sharded_counter_t *c)
+{
+    sharded_counter_add(c, 1);
+}
+
+static inline long sharded_counter_read(sharded_counter_t *c)
+{
+    long sum = 0;
+    for (int i = 0; i <= c->num_slots; i++)
+        sum += atomic_load_explicit(&c->slots[i].value, memory_order_relaxed);
+    return sum;
+}
+
+/* Returns the total and starts over; adds that race with it are counted
+ * either in the returned total or in the next one, never lost */
+static inline long sharded_counter_read_and_reset(sharded_counter_t *c)
+{
+    long sum = 0;
+    for (int i = 0; i <= c->num_slots; i++)
+        sum += atomic_exchange_explicit(&c->slots[i].value, 0,
+                                        memory_order_relaxed);
+    return sum;
+}
+
+#endif /* SHARDED_COUNTER_H */
@@ -0,0 +1,257 @@
+/*
+ * Earliest-deadline-first pool as a user-defined Argobots pool
+ *
+ * Work units are kept in a binary min-heap ordered by deadline, protected
+ * by a spinlock, so any number of execution streams may push and pop (MPMC).
+ * push and pop cost O(log n) in the number of queued units.
+ *
+ * Deadlines are attached with edf_spawn(): it creates a tasklet running
+ * edf_task_func() on an edf_task_t describing the work and its deadline.
+ * The pool recognizes such work units when it first sees them and reads
+ * their deadline; any other work unit gets its creation time as deadline,
+ * which orders it FIFO among the others.
+ *
+ * The heap grows when work units are created, not when they are pushed:
+ * push cannot fail, while a creation that runs out of memory fails with
+ * the creation call (e.g. ABT_task_create()).
+ */
+
+#ifndef EDF_POOL_H
+#define EDF_POOL_H
+
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <abt.h>
+
+enum { EDF_PENDING, EDF_DONE, EDF_DROPPED };
+
+typedef struct {
+    void (*func)(void *);
+    void *arg;
+    double deadline;           /* absolute, in ABT_get_wtime() seconds */
+    double finish_time;        /* set when func returns */
+    int status;                /* EDF_PENDING, EDF_DONE or EDF_DROPPED */
+} edf_task_t;
+
+typedef struct {
+    ABT_thread thread;
+    double deadline;
+} edf_unit_t;
+
+typedef struct {
+    atomic_flag lock;
+    edf_unit_t **heap;         /* heap[0] has the earliest deadline */
+    size_t capacity;
+    size_t num_units;          /* units created and not freed yet */
+    _Atomic size_t size;
+} edf_pool_t;
+
+/* Body of every work unit created by edf_spawn() */
+static inline void edf_task_func(void *arg)
+{
+    edf_task_t *task = (edf_task_t *)arg;
+    if (task->status == EDF_DROPPED)
+        return; /* the scheduler gave up on it */
+    task->func(task->arg);
+    task->finish_time = ABT_get_wtime();
+    task->status = EDF_DONE;
+}
+
+/* The edf_task_t of a work unit created by edf_spawn(), NULL otherwise */
+static inline edf_task_t *edf_task_of(ABT_thread thread)
+{
+    void (*func)(void *);
+    void *arg;
+    if (ABT_thread_get_thread_func(thread, &func) != ABT_SUCCESS ||
+        func != edf_task_func)
+        return NULL;
+    ABT_thread_get_arg(thread, &arg);
+    return (edf_task_t *)arg;
+}
+
+/* Create a tasklet for task in pool; task must stay valid until it runs */
+static inline int edf_spawn(ABT_pool pool, edf_task_t *task)
+{
+    task->status = EDF_PENDING;
+    task->finish_time = 0.0;
+    return ABT_task_create(pool, edf_task_func, task, NULL);
+}
+
+static inline edf_pool_t *edf_get(ABT_pool pool)
+{
+    void *data;
+    ABT_pool_get_data(pool, &data);
+    return (edf_pool_t *)data;
+}
+
+static inline void edf_lock(edf_pool_t *p)
+{
+    while (atomic_flag_test_and_set_explicit(&p->lock, memory_order_acquire))
+        ;
+}
+
+static inline void edf_unlock(edf_pool_t *p)
+{
+    atomic_flag_clear_explicit(&p->lock, memory_order_release);
+}
+
+/* Makes room for one more unit in the heap; called with the lock held */
+static inline int edf_reserve(edf_pool_t *p)
+{
+    if (p->num_units == p->capacity) {
+        size_t capacity = p->capacity ? p->capacity * 2 : 1024;
+        edf_unit_t **heap = realloc(p->heap, sizeof(edf_unit_t *) * capacity);
+        if (!heap)
+            return ABT_ERR_MEM;
+        p->heap = heap;
+        p->capacity = capacity;
+    }
+    p->num_units++;
+    return ABT_SUCCESS;
+}
+
+/* ABT_pool_user_def callbacks */
+
+static inline ABT_unit edf_create_unit(ABT_pool pool, ABT_thread thread)
+{
+    edf_pool_t *p = edf_get(pool);
+    edf_unit_t *unit = (edf_unit_t *)malloc(sizeof(edf_unit_t));
+    if (!unit)
+        return ABT_UNIT_NULL;
+
+    edf_lock(p);
+    int ret = edf_reserve(p);
+    edf_unlock(p);
+    if (ret != ABT_SUCCESS) {
+        free(unit);
+        return ABT_UNIT_NULL;
+    }
+
+    edf_task_t *task = edf_task_of(thread);
+    unit->thread = thread;
+    unit->deadline = task ? task->deadline : ABT_get_wtime();
+    return (ABT_unit)unit;
+}
+
+static inline void edf_free_unit(ABT_pool pool, ABT_unit unit)
+{
+    edf_pool_t *p = edf_get(pool);
+    edf_lock(p);
+    p->num_units--;
+    edf_unlock(p);
+    free(unit);
+}
+
+static inline size_t edf_get_size(ABT_pool pool)
+{
+    return atomic_load_explicit(&edf_get(pool)->size, memory_order_relaxed);
+}
+
+static inline ABT_bool edf_is_empty(ABT_pool pool)
+{
+    return edf_get_size(pool) == 0 ? ABT_TRUE : ABT_FALSE;
+}
+
+static inline void edf_push(ABT_pool pool, ABT_unit unit,
+                            ABT_pool_context context)
+{
+    edf_pool_t *p = edf_get(pool);
+    edf_unit_t *u = (edf_unit_t *)unit;
+
+    /* The slot was reserved when the unit was created */
+    edf_lock(p);
+    size_t i = atomic_load_explicit(&p->size, memory_order_relaxed);
+    /* Sift up */
+    while (i > 0 && p->heap[(i - 1) / 2]->deadline > u->deadline) {
+        p->heap[i] = p->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    p->heap[i] = u;
+    atomic_fetch_add_explicit(&p->size, 1, memory_order_relaxed);
+    edf_unlock(p);
+}
+
+static inline ABT_thread edf_pop(ABT_pool pool, ABT_pool_context context)
+{
+    edf_pool_t *p = edf_get(pool);
+    ABT_thread thread = ABT_THREAD_NULL;
+
+    if (atomic_load_explicit(&p->size, memory_order_relaxed) == 0)
+        return thread;
+
+    edf_lock(p);
+    size_t size = atomic_load_explicit(&p->size, memory_order_relaxed);
+    if (size > 0) {
+        thread = p->heap[0]->thread;
+        edf_unit_t *last = p->heap[--size];
+        /* Sift the last unit down from the root */
+        size_t i = 0;
+        while (2 * i + 1 < size) {
+            size_t child = 2 * i + 1;
+            if (child + 1 < size &&
+                p->heap[child + 1]->deadline < p->heap[child]->deadline)
+                child++;
+            if (last->deadline <= p->heap[child]->deadline)
+                break;
+            p->heap[i] = p->heap[child];
+            i = child;
+        }
+        p->heap[i] = last;
+        atomic_store_explicit(&p->size, size, memory_order_relaxed);
+    }
+    edf_unlock(p);
+    return thread;
+}
+
+static inline int edf_init(ABT_pool pool, ABT_pool_config config)
+{
+    edf_pool_t *p = (edf_pool_t *)malloc(sizeof(edf_pool_t));
+    if (!p)
+        return ABT_ERR_MEM;
+
+    atomic_flag_clear(&p->lock);
+    p->heap = NULL;
+    p->capacity = 0;
+    p->num_units = 0;
+    atomic_init(&p->size, 0);
+
+    ABT_pool_set_data(pool, p);
+    return ABT_SUCCESS;
+}
+
+static inline void edf_free(ABT_pool pool)
+{
+    edf_pool_t *p = edf_get(pool);
+    free(p->heap);
+    free(p);
+}
+
+/*
+ * Create an EDF pool. The pool is freed automatically together with the
+ * scheduler using it.
+ */
+static inline int edf_pool_create(ABT_pool *newpool)
+{
+    ABT_pool_user_def def;
+    ABT_pool_config config;
+    const int automatic = 1;
+    int ret;
+
+    ABT_pool_user_def_create(edf_create_unit, edf_free_unit, edf_is_empty,
+                             edf_pop, edf_push, &def);
+    ABT_pool_user_def_set_init(def, edf_init);
+    ABT_pool_user_def_set_free(def, edf_free);
+    ABT_pool_user_def_set_get_size(def, edf_get_size);
+
+    ABT_pool_config_create(&config);
+    ABT_pool_config_set(config, ABT_pool_config_automatic.key,
+                        ABT_pool_config_automatic.type, &automatic);
+
+    ret = ABT_pool_create(def, config, newpool);
+
+    ABT_pool_config_free(&config);
+    ABT_pool_user_def_free(&def);
+    return ret;
+}
+
+#endif /* EDF_POOL_H */
@@ -0,0 +1,305 @@
+/*
+ * Earliest-deadline-first scheduling with a custom pool and a custom scheduler
+ * Measures the deadline-miss rate and the pop latency with 10k-100k queued units
+ *
+ * The scheduler pops from an EDF pool (edf_pool.h) and checks the deadline of
+ * each work unit before running it. What happens to a unit whose deadline
+ * already passed depends on the policy:
+ *   run:   run it anyway (plain EDF)
+ *   drop:  skip its work; the unit completes immediately as EDF_DROPPED
+ *   defer: move it to a FIFO pool of late work, served only when no
+ *          on-time work is left
+ * Under overload, plain EDF runs late units that make the next units late
+ * too; dropping or deferring them keeps the remaining units on time.
+ *
+ * Usage: 09_abt_edf_scheduler [-x xstreams] [-n queued_units,...]
+ *                             [-w work_us] [-l load]
+ *   load is the queued work divided by the work that fits before the last
+ *   deadline; above 1, some deadlines cannot be met
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <abt.h>
+#include "edf_pool.h"
+
+#define NUM_XSTREAMS 4
+#define QUEUED_UNITS "10000,100000"
+#define MAX_SIZES 8
+#define WORK_US 20
+#define LOAD 1.2
+#define EVENT_FREQ 64
+
+enum { POLICY_RUN, POLICY_DROP, POLICY_DEFER };
+
+typedef struct {
+    _Alignas(64) long pops;
+    double pop_time;           /* total seconds spent in successful pops */
+    double pop_max;
+} edf_stats_t;
+
+typedef struct {
+    int event_freq;
+    int policy;
+    int num_pools;             /* pools[0]: work, pools[1]: late work (defer) */
+    ABT_pool pools[2];
+} sched_data_t;
+
+edf_stats_t *stats;            /* indexed by xstream rank */
+
+static ABT_sched_config_var cv_event_freq = {
+    .idx = 0,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static ABT_sched_config_var cv_policy = {
+    .idx = 1,
+    .type = ABT_SCHED_CONFIG_INT
+};
+
+static int sched_init(ABT_sched sched, ABT_sched_config config)
+{
+    sched_data_t *data = (sched_data_t *)calloc(1, sizeof(sched_data_t));
+
+    ABT_sched_config_read(config, 2, &data->event_freq, &data->policy);
+    ABT_sched_get_num_pools(sched, &data->num_pools);
+    if (data->num_pools > 2)
+        data->num_pools = 2;
+    ABT_sched_get_pools(sched, data->num_pools, 0, data->pools);
+
+    ABT_sched_set_data(sched, (void *)data);
+    return ABT_SUCCESS;
+}
+
+static void sched_run(ABT_sched sched)
+{
+    sched_data_t *data;
+    int rank, work_count = 0;
+
+    ABT_sched_get_data(sched, (void **)&data);
+    ABT_xstream_self_rank(&rank);
+    edf_stats_t *st = &stats[rank];
+
+    while (1) {
+        ABT_thread thread;
+
+        double start = ABT_get_wtime();
+        ABT_pool_pop_thread(data->pools[0], &thread);
+        if (thread != ABT_THREAD_NULL) {
+            double pop_time = ABT_get_wtime() - start;
+            st->pops++;
+            st->pop_time += pop_time;
+            if (pop_time > st->pop_max)
+                st->pop_max = pop_time;
+
+            edf_task_t *task = edf_task_of(thread);
+            if (task && task->deadline < ABT_get_wtime()) {
+                if (data->policy == POLICY_DROP) {
+                    task->status = EDF_DROPPED;
+                } else if (data->policy == POLICY_DEFER &&
+                           data->num_pools > 1) {
+                    ABT_pool_push_thread(data->pools[1], thread);
+                    thread = ABT_THREAD_NULL;
+                }
+            }
+        } else if (data->num_pools > 1) {
+            /* No on-time work left: catch up on late work */
+            ABT_pool_pop_thread(data->pools[1], &thread);
+        }
+
+        if (thread != ABT_THREAD_NULL)
+            ABT_self_schedule(thread, ABT_POOL_NULL);
+
+        if (++work_count >= data->event_freq) {
+            ABT_bool stop;
+            work_count = 0;
+            ABT_sched_has_to_stop(sched, &stop);
+            if (stop == ABT_TRUE)
+                break;
+            ABT_xstream_check_events(sched);
+        }
+    }
+}
+
+static int sched_free(ABT_sched sched)
+{
+    sched_data_t *data;
+    ABT_sched_get_data(sched, (void **)&data);
+    free(data);
+    return ABT_SUCCESS;
+}
+
+/* pools[0] is the work pool; pools[1] receives late work with POLICY_DEFER */
+int edf_sched_create(int num_pools, ABT_pool *pools, int policy,
+                     ABT_sched *sched)
+{
+    ABT_sched_config config;
+    ABT_sched_def sched_def = {
+        .type = ABT_SCHED_TYPE_ULT,
+        .init = sched_init,
+        .run = sched_run,
+        .free = sched_free,
+        .get_migr_pool = NULL
+    };
+
+    ABT_sched_config_create(&config, cv_event_freq, EVENT_FREQ,
+                            cv_policy, policy,
+                            ABT_sched_config_automatic, ABT_TRUE,
+                            ABT_sched_config_var_end);
+    int ret = ABT_sched_create(&sched_def, num_pools, pools, config, sched);
+    ABT_sched_config_free(&config);
+    return ret;
+}
+
+/* ---- Benchmark ---- */
+
+double work_time;
+
+void work_func(void *arg)
+{
+    double start = ABT_get_wtime();
+    while (ABT_get_wtime() - start < work_time)
+        ;
+}
+
+void run_mode(const char *name, int use_edf, int policy, int num_xstreams,
+              int num_units, double load)
+{
+    ABT_xstream *xstreams = malloc(sizeof(ABT_xstream) * num_xstreams);
+    edf_task_t *tasks = malloc(sizeof(edf_task_t) * num_units);
+    ABT_pool pools[2];
+    /* Deadlines spread so that the work exceeds the horizon by load */
+    double horizon = num_units * work_time / num_xstreams / load;
+    unsigned int seed = 42; /* same deadlines for every mode */
+
+    ABT_init(0, NULL);
+
+    if (use_edf) {
+        edf_pool_create(&pools[0]);
+    } else {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[0]);
+    }
+    if (policy == POLICY_DEFER) {
+        ABT_pool_create_basic(ABT_POOL_FIFO, ABT_POOL_ACCESS_MPMC, ABT_TRUE,
+                              &pools[1]);
+    }
+
+    /* Queue every unit before any worker starts. Deadlines are offsets
+     * until the queue is full, so that the pushes, which cost more in the
+     * EDF pool, do not use up part of the horizon */
+    for (int i = 0; i < num_units; i++) {
+        tasks[i].func = work_func;
+        tasks[i].arg = NULL;
+        tasks[i].deadline = horizon * rand_r(&seed) / (double)RAND_MAX;
+        if (edf_spawn(pools[0], &tasks[i]) != ABT_SUCCESS) {
+            fprintf(stderr, "Error: cannot queue %d units\n", num_units);
+            exit(1);
+        }
+    }
+    /* The pool keeps the offsets it sorted the units by: adding the same
+     * start time to every deadline does not change their order */
+    double start_time = ABT_get_wtime();
+    for (int i = 0; i < num_units; i++)
+        tasks[i].deadline += start_time;
+
+    memset(stats, 0, sizeof(edf_stats_t) * (num_xstreams + 1));
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_sched sched;
+        edf_sched_create(policy == POLICY_DEFER ? 2 : 1, pools, policy,
+                         &sched);
+        ABT_xstream_create(sched, &xstreams[i]);
+    }
+    for (int i = 0; i < num_xstreams; i++) {
+        ABT_xstream_join(xstreams[i]);
+        ABT_xstream_free(&xstreams[i]);
+    }
+    double elapsed = ABT_get_wtime() - start_time;
+    ABT_finalize();
+
+    long on_time = 0, late = 0, dropped = 0, pops = 0;
+    double pop_time = 0.0, pop_max = 0.0;
+    for (int i = 0; i < num_units; i++) {
+        if (tasks[i].status == EDF_DROPPED)
+            dropped++;
+        else if (tasks[i].finish_time <= tasks[i].deadline)
+            on_time++;
+        else
+            late++;
+    }
+    for (int i = 0; i <= num_xstreams; i++) {
+        pops += stats[i].pops;
+        pop_time += stats[i].pop_time;
+        if (stats[i].pop_max > pop_max)
+            pop_max = stats[i].pop_max;
+    }
+    printf("%8d %-10s %9ld %9ld %9ld %8.1f %12.0f %12.1f %9.3f\n",
+           num_units, name, on_time, late, dropped,
+           100.0 * (late + dropped) / num_units,
+           pops ? pop_time / pops * 1e9 : 0.0, pop_max * 1e6, elapsed);
+
+    free(tasks);
+    free(xstreams);
+}
+
+int main(int argc, char **argv)
+{
+    int num_xstreams = NUM_XSTREAMS;
+    char size_list[256] = QUEUED_UNITS;
+    int sizes[MAX_SIZES], num_sizes = 0;
+    int work_us = WORK_US;
+    double load = LOAD;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "x:n:w:l:")) != -1) {
+        switch (opt) {
+            case 'x': num_xstreams = atoi(optarg); break;
+            case 'n':
+                snprintf(size_list, sizeof(size_list), "%s", optarg);
+                break;
+            case 'w': work_us = atoi(optarg); break;
+            case 'l': load = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-x xstreams] "
+                        "[-n queued_units,...] [-w work_us] [-l load]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    for (char *tok = strtok(size_list, ","); tok && num_sizes < MAX_SIZES;
+         tok = strtok(NULL, ",")) {
+        sizes[num_sizes] = atoi(tok);
+        if (sizes[num_sizes] < 1) {
+            fprintf(stderr, "Error: queued units must be >= 1\n");
+            return 1;
+        }
+        num_sizes++;
+    }
+    if (num_xstreams < 1 || work_us < 1 || load <= 0) {
+        fprintf(stderr, "Error: invalid argument\n");
+        return 1;
+    }
+    work_time = work_us * 1e-6;
+    /* Secondary xstreams have ranks 1..num_xstreams */
+    stats = aligned_alloc(64, sizeof(edf_stats_t) * (num_xstreams + 1));
+
+    printf("=== Earliest-Deadline-First Pool and Scheduler ===\n");
+    printf("%d xstreams, %d us per unit, load %.2f\n\n", num_xstreams, work_us,
+           load);
+    printf("%8s %-10s %9s %9s %9s %8s %12s %12s %9s\n", "queued", "mode",
+           "on time", "late", "dropped", "miss(%)", "pop avg(ns)",
+           "pop max(us)", "time(s)");
+
+    for (int s = 0; s < num_sizes; s++) {
+        run_mode("fifo", 0, POLICY_RUN, num_xstreams, sizes[s], load);
+        run_mode("edf", 1, POLICY_RUN, num_xstreams, sizes[s], load);
+        run_mode("edf+drop", 1, POLICY_DROP, num_xstreams, sizes[s], load);
+        run_mode("edf+defer", 1, POLICY_DEFER, num_xstreams, sizes[s], load);
+    }
+
+    printf("\nDropped units count as misses; late units ran after their deadline\n");
+    free(stats);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#!/bin/sh
+#
+# Strong-scaling sweep driver for the Argobots examples
+#
+# Runs an example that understands "-x <xstreams> -c" (for instance
+# 02_abt_work_stealing or 04_abt_fibonacci) once per xstream count and
+# writes a CSV file with throughput, speedup and parallel efficiency.
+#
+# Usage: scaling_sweep.sh [-m max_xstreams] [-l "1 2 4 ..."] [-r repeats]
+#                         [-o output.csv] -- <example> [example options]
+#
+#   -m  sweep 1..max_xstreams (default: number of online cores)
+#   -l  explicit list of xstream counts, overrides -m
+#   -r  run each point this many times and keep the fastest (default: 3)
+#   -o  output file (default: stdout)
+#
+# Example:
+#   scaling_sweep.sh -l "1 2 4 8 16 32 64" -o fib.csv -- ./04_abt_fibonacci -n 32
+#
+# Speedup is computed against the first point of the sweep (normally one
+# xstream). The first xstream count whose efficiency falls below 80% is
+# reported on stderr as the knee of the scaling curve.
+
+max_xstreams=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)
+list=""
+repeats=3
+output=""
+
+while getopts "m:l:r:o:" opt; do
+    case $opt in
+        m) max_xstreams=$OPTARG ;;
+        l) list=$OPTARG ;;
+        r) repeats=$OPTARG ;;
+        o) output=$OPTARG ;;
+        *) sed -n '9,15p' "$0" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+[ "$1" = "--" ] && shift
+
+if [ $# -lt 1 ]; then
+    echo "Error: no example given" >&2
+    sed -n '9,15p' "$0" >&2
+    exit 1
+fi
+
+[ -z "$list" ] && list=$(seq 1 "$max_xstreams")
+
+# Collect the fastest run of each point: benchmark,xstreams,units,size,seconds,throughput
+results=""
+for x in $list; do
+    best=""
+    r=0
+    while [ $r -lt "$repeats" ]; do
+        out=$("$@" -x "$x" -c) || {
+            echo "Error: $* failed at $x xstreams" >&2
+            exit 1
+        }
+        line=$(printf '%s\n' "$out" | tail -n 1)
+        best=$(printf '%s\n%s\n' "$best" "$line" |
+               awk -F, 'NF >= 6 { print $5 "," $0 }' | sort -t, -g -k1,1 |
+               head -n 1 | cut -d, -f2-)
+        r=$((r + 1))
+    done
+    if [ -z "$best" ]; then
+        echo "Error: $* printed no CSV line at $x xstreams" >&2
+        exit 1
+    fi
+    echo "xstreams=$x: $best" >&2
+    results="$results$best
+"
+done
+
+printf '%s' "$results" | awk -F, '
+    BEGIN { OFS = ","
+            print "benchmark,xstreams,units,size,seconds,throughput,speedup,efficiency" }
+    NF >= 6 && $5 <= 0 {
+        printf "Error: %s took %s seconds at %s xstreams\n", $1, $5, $2 > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+    NF >= 6 {
+        if (base_time == "") { base_time = $5; base_x = $2 }
+        speedup = base_x * base_time / $5
+        efficiency = speedup / $2
+        if (knee == "" && efficiency < 0.8) knee = $2
+        printf "%s,%d,%s,%s,%s,%s,%.3f,%.3f\n", $1, $2, $3, $4, $5, $6, speedup, efficiency
+    }
+    END {
+        if (failed)
+            exit 1
+        if (knee != "")
+            printf "Knee: efficiency drops below 80%% at %d xstreams\n", knee > "/dev/stderr"
+        else
+            print "No knee: efficiency stays above 80% for the whole sweep" > "/dev/stderr"
+    }' > "${output:-/dev/stdout}"